@@ -19,16 +19,92 @@
 #ifndef VX16_H_INCLUDED
 #define VX16_H_INCLUDED
 
+// With VX16_LIBRARY defined, rarely used parts of the emulator are only declared here and compiled
+// once into vx16 library, its source defines VX16_IMPLEMENTATION to get definitions of them
+#if !defined VX16_LIBRARY || defined VX16_IMPLEMENTATION
+#define VX16_INCLUDE_IMPLEMENTATION
+#endif
+
+#ifdef VX16_LIBRARY
+#define VX16_INLINE
+#else // !VX16_LIBRARY
+#define VX16_INLINE inline
+#endif // VX16_LIBRARY
+
+// Module interface defines it as export, see src/vx16.cppm
+#ifndef VX16_EXPORT
+#define VX16_EXPORT
+#endif // !VX16_EXPORT
+
+// Namespace scope constants must not have internal linkage to be used in exported templates
+#if __cplusplus >= 201703L
+#define VX16_CONSTANT inline constexpr
+#else // __cplusplus < 201703L
+#define VX16_CONSTANT const
+#endif // __cplusplus >= 201703L
+
+#include <cstddef>
 #include <cstdint>
 #include <cassert>
+#include <cstring>
 #include <array>
+#include <iterator>
+#include <map>
+#include <set>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-namespace vx16
+#ifdef VX16_INCLUDE_IMPLEMENTATION
+#include <algorithm>
+#include <cmath>
+#endif // VX16_INCLUDE_IMPLEMENTATION
+
+#ifdef VX16_WATCHPOINTS
+#include <functional>
+#endif
+
+#ifdef VX16_PROFILER
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <source_location>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+// Instruction methods receive location of their call site via default argument
+#define VX16_SOURCE_LOCATION , const std::source_location& location = std::source_location::current()
+#define VX16_SOURCE_LOCATION_ONLY const std::source_location& location = std::source_location::current()
+#define VX16_SOURCE_LOCATION_PARAMETER , const std::source_location& location
+#define VX16_SOURCE_LOCATION_ARGUMENT , location
+#define VX16_PROFILE(BYTES) Profiler::record(location, BYTES, m_profilerNode)
+#else // !VX16_PROFILER
+#define VX16_SOURCE_LOCATION
+#define VX16_SOURCE_LOCATION_ONLY
+#define VX16_SOURCE_LOCATION_PARAMETER
+#define VX16_SOURCE_LOCATION_ARGUMENT
+#define VX16_PROFILE(BYTES)
+#endif // VX16_PROFILER
+
+VX16_EXPORT namespace vx16
 {
 
+    using std::size_t;
+
     typedef uint8_t byte_t;
     typedef uint16_t word_t;
+    typedef uint32_t dword_t;
+    typedef uint64_t qword_t;
+
+    // x87 double extended precision value as stored in memory
+    struct Float80
+    {
+        qword_t m_significand; // with explicit integer bit
+        word_t m_signExponent;
+    };
 
     struct NearBytePtr
     {
@@ -52,6 +128,64 @@ namespace vx16
         word_t m_offset;
     };
 
+    struct NearDwordPtr
+    {
+        word_t m_offset;
+    };
+
+    struct FarDwordPtr
+    {
+        word_t m_segment;
+        word_t m_offset;
+    };
+
+    struct NearQwordPtr
+    {
+        word_t m_offset;
+    };
+
+    struct FarQwordPtr
+    {
+        word_t m_segment;
+        word_t m_offset;
+    };
+
+    struct NearTbytePtr
+    {
+        word_t m_offset;
+    };
+
+    struct FarTbytePtr
+    {
+        word_t m_segment;
+        word_t m_offset;
+    };
+
+    class CPU;
+
+#ifdef VX16_WATCHPOINTS
+
+    enum class Watch : byte_t
+    {
+        READ   = 1,
+        WRITE  = 2,
+        ACCESS = READ | WRITE
+    };
+
+    struct WatchHit
+    {
+        const CPU* m_cpu; // CPU attached to memory, null if none
+        size_t m_id;
+        word_t m_segment;
+        word_t m_offset;
+        size_t m_size;
+        Watch m_access;   // either READ or WRITE
+    };
+
+    typedef std::function<void(const WatchHit&)> WatchCallback;
+
+#endif // VX16_WATCHPOINTS
+
     class Memory
     {
     public:
@@ -75,11 +209,53 @@ namespace vx16
             set(address.m_segment, address.m_offset, value);
         }
 
+        dword_t get(FarDwordPtr address) const
+        {
+            return get<dword_t>(address.m_segment, address.m_offset);
+        }
+
+        void set(FarDwordPtr address, dword_t value)
+        {
+            set(address.m_segment, address.m_offset, value);
+        }
+
+        qword_t get(FarQwordPtr address) const
+        {
+            return get<qword_t>(address.m_segment, address.m_offset);
+        }
+
+        void set(FarQwordPtr address, qword_t value)
+        {
+            set(address.m_segment, address.m_offset, value);
+        }
+
+        Float80 get(FarTbytePtr address) const
+        {
+            const qword_t significand = get<qword_t>(address.m_segment, address.m_offset);
+            const word_t signExponent = get<word_t>(address.m_segment, address.m_offset + 8);
+            return Float80{ significand, signExponent };
+        }
+
+        void set(FarTbytePtr address, Float80 value)
+        {
+            set(address.m_segment, address.m_offset, value.m_significand);
+            set(address.m_segment, word_t(address.m_offset + 8), value.m_signExponent);
+        }
+
         template <typename T>
         T get(word_t segment, word_t offset) const
         {
             const Page& page = m_storage[segment];
-            return *reinterpret_cast<const T*>(&page[offset]);
+            const T value = *reinterpret_cast<const T*>(&page[offset]);
+
+#ifdef VX16_WATCHPOINTS
+            if (m_watchMasks[segment] & watchMask(offset, sizeof(T), Watch::READ))
+            {
+                hitWatch(segment, offset, sizeof(T), Watch::READ);
+            }
+#endif // VX16_WATCHPOINTS
+
+            return value;
         }
 
         template <typename T>
@@ -87,11 +263,21 @@ namespace vx16
         {
             Page& page = m_storage[segment];
             *reinterpret_cast<T*>(&page[offset]) = value;
+
+#ifdef VX16_WATCHPOINTS
+            if (m_watchMasks[segment] & watchMask(offset, sizeof(T), Watch::WRITE))
+            {
+                hitWatch(segment, offset, sizeof(T), Watch::WRITE);
+            }
+#endif // VX16_WATCHPOINTS
         }
 
         word_t allocPage()
         {
             m_storage.emplace_back();
+#ifdef VX16_WATCHPOINTS
+            m_watchMasks.push_back(0);
+#endif // VX16_WATCHPOINTS
             return pageCount() - 1;
         }
 
@@ -100,6 +286,85 @@ namespace vx16
             return static_cast<word_t>(m_storage.size());
         }
 
+        // Bulk copy for string instructions, ranges must not cross the end of page
+        // Nothing is copied and false is returned when the result would differ from a sequence
+        // of forward element moves, i.e. destination overlaps the tail of source, or when watchpoints
+        // need to observe individual accesses, the caller should fall back to element moves then
+        bool copy(word_t dstSegment, word_t dstOffset, word_t srcSegment, word_t srcOffset, size_t size)
+        {
+            assert(size > 0 && dstOffset + size <= PAGE_SIZE && srcOffset + size <= PAGE_SIZE);
+
+            if (dstSegment == srcSegment && srcOffset < dstOffset && dstOffset < srcOffset + size)
+            {
+                return false;
+            }
+
+#ifdef VX16_WATCHPOINTS
+            if ((m_watchMasks[srcSegment] & watchRangeMask(srcOffset, size, Watch::READ))
+                || (m_watchMasks[dstSegment] & watchRangeMask(dstOffset, size, Watch::WRITE)))
+            {
+                return false;
+            }
+#endif // VX16_WATCHPOINTS
+
+            memmove(&m_storage[dstSegment][dstOffset], &m_storage[srcSegment][srcOffset], size);
+            return true;
+        }
+
+#ifdef VX16_WATCHPOINTS
+
+        // Registers watchpoint on [offset, offset + size) range of the given segment
+        // Callback is invoked after every matching access, returns watchpoint ID
+        size_t watch(word_t segment, word_t offset, size_t size, Watch access, WatchCallback callback)
+        {
+            assert(segment < pageCount());
+            assert(size > 0 && offset + size <= PAGE_SIZE);
+            assert(callback);
+
+            m_watches.push_back(Watchpoint{ ++m_lastWatchID, segment, offset, size, access, std::move(callback) });
+
+            updateWatchMask(segment);
+            return m_lastWatchID;
+        }
+
+        void unwatch(size_t id)
+        {
+            for (auto it = m_watches.begin(), end = m_watches.end(); it != end; ++it)
+            {
+                if (it->m_id == id)
+                {
+                    const word_t segment = it->m_segment;
+                    m_watches.erase(it);
+                    updateWatchMask(segment);
+                    return;
+                }
+            }
+
+            assert(!"unknown watchpoint");
+        }
+
+        size_t watchCount() const
+        {
+            return m_watches.size();
+        }
+
+        // CPU reported to watchpoint callbacks, done automatically on its creation
+        void attachCPU(const CPU* cpu)
+        {
+            m_cpu = cpu;
+        }
+
+        // Done automatically on CPU destruction, another CPU attached later stays attached
+        void detachCPU(const CPU* cpu)
+        {
+            if (m_cpu == cpu)
+            {
+                m_cpu = nullptr;
+            }
+        }
+
+#endif // VX16_WATCHPOINTS
+
     private:
         static const size_t PAGE_SIZE = 64 * 1024;
 
@@ -107,329 +372,3773 @@ namespace vx16
         typedef std::vector<Page> Storage;
 
         Storage m_storage;
+
+#ifdef VX16_WATCHPOINTS
+
+        // Each page is split into 16 blocks of 4 KB, a mask per page has one bit per block
+        // for reads in the low half and one bit per block for writes in the high half
+        static const size_t WATCH_BLOCK_SHIFT = 12;
+        static const size_t WATCH_BLOCK_COUNT = PAGE_SIZE >> WATCH_BLOCK_SHIFT;
+
+        struct Watchpoint
+        {
+            size_t m_id;
+            word_t m_segment;
+            word_t m_offset;
+            size_t m_size;
+            Watch m_access;
+            WatchCallback m_callback;
+        };
+
+        typedef std::vector<Watchpoint> Watchpoints;
+
+        std::vector<uint32_t> m_watchMasks;
+        Watchpoints m_watches;
+        size_t m_lastWatchID = 0;
+        const CPU* m_cpu = nullptr;
+
+        static uint32_t watchMask(size_t offset, size_t size, Watch access)
+        {
+            const size_t first = offset >> WATCH_BLOCK_SHIFT;
+            const size_t last = ((offset + size - 1) >> WATCH_BLOCK_SHIFT) % WATCH_BLOCK_COUNT;
+            const uint32_t blocks = (1u << first) | (1u << last);
+
+            return Watch::READ == access ? blocks : blocks << WATCH_BLOCK_COUNT;
+        }
+
+        // Unlike watchMask(), every block of the range is included
+        static uint32_t watchRangeMask(size_t offset, size_t size, Watch access)
+        {
+            const size_t first = offset >> WATCH_BLOCK_SHIFT;
+            const size_t last = (offset + size - 1) >> WATCH_BLOCK_SHIFT;
+            const uint32_t blocks = ((2u << last) - 1) & ~((1u << first) - 1);
+
+            return Watch::READ == access ? blocks : blocks << WATCH_BLOCK_COUNT;
+        }
+
+        void updateWatchMask(word_t segment)
+        {
+            uint32_t mask = 0;
+
+            for (const Watchpoint& watchpoint : m_watches)
+            {
+                if (watchpoint.m_segment != segment)
+                {
+                    continue;
+                }
+
+                const size_t access = static_cast<size_t>(watchpoint.m_access);
+
+                for (size_t offset = watchpoint.m_offset & ~((1 << WATCH_BLOCK_SHIFT) - 1),
+                        end = watchpoint.m_offset + watchpoint.m_size; offset < end; offset += 1 << WATCH_BLOCK_SHIFT)
+                {
+                    if (access & static_cast<size_t>(Watch::READ))
+                    {
+                        mask |= watchMask(offset, 1, Watch::READ);
+                    }
+
+                    if (access & static_cast<size_t>(Watch::WRITE))
+                    {
+                        mask |= watchMask(offset, 1, Watch::WRITE);
+                    }
+                }
+            }
+
+            m_watchMasks[segment] = mask;
+        }
+
+        // Slow path, taken only for accesses to watched blocks
+        void hitWatch(word_t segment, word_t offset, size_t size, Watch access) const
+        {
+            // Watchpoints are ordered by ID, those added by callbacks during this access are skipped
+            const size_t lastID = m_lastWatchID;
+            size_t index = 0;
+
+            while (index < m_watches.size() && m_watches[index].m_id <= lastID)
+            {
+                const Watchpoint& watchpoint = m_watches[index];
+
+                if (watchpoint.m_segment != segment
+                    || !(static_cast<size_t>(watchpoint.m_access) & static_cast<size_t>(access))
+                    || offset >= watchpoint.m_offset + watchpoint.m_size
+                    || offset + size <= watchpoint.m_offset)
+                {
+                    ++index;
+                    continue;
+                }
+
+                // Callback is allowed to add and remove watchpoints, including its own
+                const size_t id = watchpoint.m_id;
+                const WatchCallback callback = watchpoint.m_callback;
+                const WatchHit hit = { m_cpu, id, segment, offset, size, access };
+                callback(hit);
+
+                index = 0;
+
+                while (index < m_watches.size() && m_watches[index].m_id <= id)
+                {
+                    ++index;
+                }
+            }
+        }
+
+#endif // VX16_WATCHPOINTS
     };
 
-    enum class R8 : byte_t
+    // Error codes as returned by DOS memory functions in AX
+    enum class DosError : word_t
     {
-        AL = 0,
-        AH = 1,
-        BL = 2,
-        BH = 3,
-        CL = 4,
-        CH = 5,
-        DL = 6,
-        DH = 7
+        NONE                = 0,
+        MCB_DESTROYED       = 7,
+        INSUFFICIENT_MEMORY = 8,
+        INVALID_BLOCK       = 9
+    };
+
+    // Allocation strategies of DOS function 58h
+    enum class DosStrategy : byte_t
+    {
+        FIRST_FIT = 0, // default, the lowest block large enough
+        BEST_FIT  = 1, // the smallest block large enough
+        LAST_FIT  = 2  // upper part of the highest block large enough
     };
 
-    enum class R16 : byte_t
-    {
-        AX = 0,
-        BX = 1,
-        CX = 2,
-        DX = 3,
+    // Conventional memory allocator compatible with DOS functions 48h, 49h, 4Ah and 58h
+    // Blocks are allocated in 16-byte paragraphs within one page that starts with memory control block chain,
+    // the chain is kept valid for guest code while searches use host-side indices of free blocks
+    class DosAllocator
+    {
+    public:
+        static const word_t PARAGRAPH_SIZE = 16;
+        static const word_t PARAGRAPH_COUNT = 0x1000;
+        static const word_t SYSTEM_OWNER = 0x0008;
+
+        // Memory control block layout
+        static const word_t MCB_SIGNATURE = 0;
+        static const word_t MCB_OWNER     = 1;
+        static const word_t MCB_SIZE      = 3;
+        static const word_t MCB_NAME      = 8;
+
+        static const byte_t SIGNATURE_MIDDLE = 'M';
+        static const byte_t SIGNATURE_LAST   = 'Z';
+
+        explicit DosAllocator(Memory* memory);
+
+        // Page of memory control block chain
+        word_t segment() const { return m_segment; }
+
+        // Address of block data, block is paragraph number within allocator's page
+        FarBytePtr address(word_t block) const;
+
+        // Function 48h, on failure block receives size of the largest free block
+        DosError allocate(word_t paragraphs, word_t& block, word_t owner = SYSTEM_OWNER);
+
+        // Function 49h
+        DosError free(word_t block);
+
+        // Function 4Ah, block is never moved, on failure maximum receives the largest possible size
+        // Like DOS 2.1-6.0, failed attempt to grow the block still grows it to that size
+        DosError resize(word_t block, word_t paragraphs, word_t& maximum);
+
+        // Function 58h, subfunctions 00h and 01h
+        DosStrategy strategy() const { return m_strategy; }
+        void setStrategy(DosStrategy strategy) { m_strategy = strategy; }
+
+        word_t largestFree() const;
+        word_t freeParagraphs() const;
+
+        // Walks memory control block chain in guest memory and compares it with host-side index
+        bool isChainValid() const;
+
+    private:
+        struct Block
+        {
+            word_t m_size;  // in paragraphs, not including control block
+            word_t m_owner; // zero for free block
+        };
+
+        typedef std::map<word_t, Block> Blocks;     // by paragraph of control block
+        typedef std::pair<word_t, word_t> Key;      // size and paragraph of control block
+        typedef std::set<Key> FreeIndex;            // ordered by size for best fit search
+
+        // Segment tree over paragraphs of control blocks for first and last fit search,
+        // node holds the largest size + 1 of free blocks in its range, zero if there are none
+        typedef std::vector<word_t> FreeTree;
+
+        Memory* m_memory;
+        word_t m_segment;
+        DosStrategy m_strategy;
+
+        Blocks m_blocks;
+        FreeIndex m_free;
+        FreeTree m_freeTree;
+
+        void writeMCB(word_t mcb, word_t owner, word_t size);
+        Blocks::iterator findUsed(word_t block, DosError& error);
+
+        // Control block of free block to allocate according to the current strategy, false if none
+        bool findFree(word_t paragraphs, word_t& mcb) const;
+
+        void addFree(word_t mcb, word_t size);
+        void removeFree(word_t mcb, word_t size);
+        void updateFreeTree(word_t mcb, word_t value);
+
+        // Splits the tail of used block to free block
+        void shrink(word_t mcb, word_t paragraphs);
+
+        // Merges free block with its free neighbors and adds the result to index
+        void release(Blocks::iterator it);
+    };
+
+#ifdef VX16_INCLUDE_IMPLEMENTATION
+
+    VX16_INLINE DosAllocator::DosAllocator(Memory* memory)
+    : m_memory(memory)
+    , m_segment(memory->allocPage())
+    , m_strategy(DosStrategy::FIRST_FIT)
+    , m_freeTree(PARAGRAPH_COUNT * 2, 0)
+    {
+        const word_t size = PARAGRAPH_COUNT - 1;
+        writeMCB(0, 0, size);
+        m_blocks[0] = Block{ size, 0 };
+        addFree(0, size);
+    }
+
+    VX16_INLINE FarBytePtr DosAllocator::address(word_t block) const
+    {
+        return FarBytePtr{ m_segment, word_t(block * PARAGRAPH_SIZE) };
+    }
+
+    VX16_INLINE DosError DosAllocator::allocate(word_t paragraphs, word_t& block, word_t owner)
+    {
+        assert(0 != owner && "owner must not be zero");
+
+        word_t mcb = 0;
+
+        if (!findFree(paragraphs, mcb))
+        {
+            block = largestFree();
+            return DosError::INSUFFICIENT_MEMORY;
+        }
+
+        Block& info = m_blocks[mcb];
+        removeFree(mcb, info.m_size);
+
+        if (DosStrategy::LAST_FIT == m_strategy && info.m_size != paragraphs)
+        {
+            // Lower part of the block stays free
+            const word_t head = info.m_size - paragraphs - 1;
+            info.m_size = head;
+            writeMCB(mcb, 0, head);
+            addFree(mcb, head);
+
+            mcb += head + 1;
+            m_blocks[mcb] = Block{ paragraphs, owner };
+            writeMCB(mcb, owner, paragraphs);
+        }
+        else
+        {
+            info.m_owner = owner;
+            writeMCB(mcb, owner, info.m_size);
+            shrink(mcb, paragraphs);
+        }
+
+        block = mcb + 1;
+        return DosError::NONE;
+    }
+
+    VX16_INLINE DosError DosAllocator::free(word_t block)
+    {
+        DosError error = DosError::NONE;
+        const Blocks::iterator it = findUsed(block, error);
+
+        if (DosError::NONE != error)
+        {
+            return error;
+        }
+
+        it->second.m_owner = 0;
+        writeMCB(it->first, 0, it->second.m_size);
+        release(it);
+
+        return DosError::NONE;
+    }
+
+    VX16_INLINE DosError DosAllocator::resize(word_t block, word_t paragraphs, word_t& maximum)
+    {
+        DosError error = DosError::NONE;
+        const Blocks::iterator it = findUsed(block, error);
+
+        if (DosError::NONE != error)
+        {
+            return error;
+        }
+
+        const word_t mcb = it->first;
+        Block& info = it->second;
+
+        if (paragraphs > info.m_size)
+        {
+            const Blocks::iterator next = std::next(it);
+
+            // Free block that follows is merged even if the result is still too small
+            if (m_blocks.end() != next && 0 == next->second.m_owner)
+            {
+                removeFree(next->first, next->second.m_size);
+                info.m_size += next->second.m_size + 1;
+                m_blocks.erase(next);
+                writeMCB(mcb, info.m_owner, info.m_size);
+            }
+
+            if (paragraphs > info.m_size)
+            {
+                maximum = info.m_size;
+                return DosError::INSUFFICIENT_MEMORY;
+            }
+        }
+
+        shrink(mcb, paragraphs);
+
+        return DosError::NONE;
+    }
+
+    VX16_INLINE word_t DosAllocator::largestFree() const
+    {
+        return m_free.empty() ? 0 : m_free.rbegin()->first;
+    }
+
+    VX16_INLINE word_t DosAllocator::freeParagraphs() const
+    {
+        word_t result = 0;
+
+        for (FreeIndex::const_iterator it = m_free.begin(), end = m_free.end(); it != end; ++it)
+        {
+            result += it->first;
+        }
+
+        return result;
+    }
+
+    VX16_INLINE bool DosAllocator::isChainValid() const
+    {
+        word_t mcb = 0;
+        Blocks::const_iterator it = m_blocks.begin();
+
+        for (;;)
+        {
+            if (m_blocks.end() == it || it->first != mcb)
+            {
+                return false;
+            }
+
+            const byte_t signature = m_memory->get(FarBytePtr{ m_segment, word_t(mcb * PARAGRAPH_SIZE + MCB_SIGNATURE) });
+            const word_t owner = m_memory->get(FarWordPtr{ m_segment, word_t(mcb * PARAGRAPH_SIZE + MCB_OWNER) });
+            const word_t size = m_memory->get(FarWordPtr{ m_segment, word_t(mcb * PARAGRAPH_SIZE + MCB_SIZE) });
+            const bool isLast = PARAGRAPH_COUNT == mcb + size + 1;
+
+            if (owner != it->second.m_owner
+                || size != it->second.m_size
+                || signature != (isLast ? SIGNATURE_LAST : SIGNATURE_MIDDLE))
+            {
+                return false;
+            }
+
+            ++it;
+
+            if (isLast)
+            {
+                return m_blocks.end() == it;
+            }
+
+            mcb += size + 1;
+        }
+    }
+
+    VX16_INLINE void DosAllocator::writeMCB(word_t mcb, word_t owner, word_t size)
+    {
+        const word_t offset = mcb * PARAGRAPH_SIZE;
+        const bool isLast = PARAGRAPH_COUNT == mcb + size + 1;
+
+        m_memory->set(FarBytePtr{ m_segment, word_t(offset + MCB_SIGNATURE) }, isLast ? SIGNATURE_LAST : SIGNATURE_MIDDLE);
+        m_memory->set(FarWordPtr{ m_segment, word_t(offset + MCB_OWNER) }, owner);
+        m_memory->set(FarWordPtr{ m_segment, word_t(offset + MCB_SIZE) }, size);
+    }
+
+    VX16_INLINE DosAllocator::Blocks::iterator DosAllocator::findUsed(word_t block, DosError& error)
+    {
+        const Blocks::iterator result = 0 == block ? m_blocks.end() : m_blocks.find(block - 1);
+
+        if (m_blocks.end() == result || 0 == result->second.m_owner)
+        {
+            error = DosError::INVALID_BLOCK;
+            return result;
+        }
+
+        const byte_t signature = m_memory->get(FarBytePtr{ m_segment, word_t(result->first * PARAGRAPH_SIZE + MCB_SIGNATURE) });
+
+        if (SIGNATURE_MIDDLE != signature && SIGNATURE_LAST != signature)
+        {
+            error = DosError::MCB_DESTROYED;
+        }
+
+        return result;
+    }
+
+    VX16_INLINE void DosAllocator::shrink(word_t mcb, word_t paragraphs)
+    {
+        Block& info = m_blocks[mcb];
+
+        if (info.m_size == paragraphs)
+        {
+            return;
+        }
+
+        const word_t tail = mcb + paragraphs + 1;
+        const word_t tailSize = info.m_size - paragraphs - 1;
+
+        info.m_size = paragraphs;
+        writeMCB(mcb, info.m_owner, paragraphs);
+
+        writeMCB(tail, 0, tailSize);
+        release(m_blocks.insert(Blocks::value_type(tail, Block{ tailSize, 0 })).first);
+    }
+
+    VX16_INLINE void DosAllocator::release(Blocks::iterator it)
+    {
+        const Blocks::iterator next = std::next(it);
+
+        if (m_blocks.end() != next && 0 == next->second.m_owner)
+        {
+            removeFree(next->first, next->second.m_size);
+            it->second.m_size += next->second.m_size + 1;
+            m_blocks.erase(next);
+        }
+
+        if (m_blocks.begin() != it)
+        {
+            const Blocks::iterator previous = std::prev(it);
+
+            if (0 == previous->second.m_owner)
+            {
+                removeFree(previous->first, previous->second.m_size);
+                previous->second.m_size += it->second.m_size + 1;
+                m_blocks.erase(it);
+                it = previous;
+            }
+        }
+
+        writeMCB(it->first, 0, it->second.m_size);
+        addFree(it->first, it->second.m_size);
+    }
+
+    VX16_INLINE bool DosAllocator::findFree(word_t paragraphs, word_t& mcb) const
+    {
+        if (DosStrategy::BEST_FIT == m_strategy)
+        {
+            const FreeIndex::const_iterator found = m_free.lower_bound(Key(paragraphs, 0));
+
+            if (m_free.end() == found)
+            {
+                return false;
+            }
+
+            mcb = found->second;
+            return true;
+        }
+
+        const size_t needed = size_t(paragraphs) + 1;
+
+        if (m_freeTree[1] < needed)
+        {
+            return false;
+        }
+
+        // Descend to the leftmost or, for last fit, the rightmost leaf large enough
+        const bool isLastFit = DosStrategy::LAST_FIT == m_strategy;
+        size_t node = 1;
+
+        while (node < PARAGRAPH_COUNT)
+        {
+            node *= 2;
+
+            if (isLastFit ? m_freeTree[node + 1] >= needed : m_freeTree[node] < needed)
+            {
+                ++node;
+            }
+        }
+
+        mcb = static_cast<word_t>(node - PARAGRAPH_COUNT);
+        return true;
+    }
+
+    VX16_INLINE void DosAllocator::addFree(word_t mcb, word_t size)
+    {
+        m_free.insert(Key(size, mcb));
+        updateFreeTree(mcb, size + 1);
+    }
+
+    VX16_INLINE void DosAllocator::removeFree(word_t mcb, word_t size)
+    {
+        m_free.erase(Key(size, mcb));
+        updateFreeTree(mcb, 0);
+    }
+
+    VX16_INLINE void DosAllocator::updateFreeTree(word_t mcb, word_t value)
+    {
+        size_t node = PARAGRAPH_COUNT + mcb;
+        m_freeTree[node] = value;
+
+        for (node /= 2; 0 != node; node /= 2)
+        {
+            m_freeTree[node] = std::max(m_freeTree[node * 2], m_freeTree[node * 2 + 1]);
+        }
+    }
+
+#endif // VX16_INCLUDE_IMPLEMENTATION
+
+#ifdef VX16_PROFILER
+
+    // Attributes executed instructions to C++ call sites of CPU methods
+    // Every thread records into its own table without any locking,
+    // reading results requires profiled threads to be idle
+    class Profiler
+    {
+    public:
+        struct Site
+        {
+            std::string m_callers;  // functions performed CPU calls, outermost first, separated by ';'
+            const char* m_file;
+            const char* m_function;
+            uint32_t m_line;
+
+            uint64_t m_instructions;
+            uint64_t m_bytes;       // guest memory read and written
+            uint64_t m_nanoseconds; // wall time until the next instruction on the same thread
+        };
+
+        typedef std::vector<Site> Sites;
+
+        enum class Metric
+        {
+            INSTRUCTIONS,
+            BYTES,
+            NANOSECONDS
+        };
+
+        // Node of guest call tree, unique within a thread, zero is the root
+        typedef uint32_t Node;
+
+        static void record(const std::source_location& location, size_t bytes, Node node)
+        {
+            ThreadTable& table = threadTable();
+            const Clock::time_point now = Clock::now();
+
+            if (nullptr != table.m_lastCounters)
+            {
+                table.m_lastCounters->m_nanoseconds += static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - table.m_lastTime).count());
+            }
+
+            const Key key = { location.file_name(), location.function_name(), location.line(), node };
+            Counters& counters = table.m_sites[key];
+
+            ++counters.m_instructions;
+            counters.m_bytes += bytes;
+
+            table.m_lastCounters = &counters;
+            table.m_lastTime = now;
+        }
+
+        // Returns call tree node for a call made from the given location
+        static Node enter(const std::source_location& location, Node parent)
+        {
+            ThreadTable& table = threadTable();
+            const Key key = { location.file_name(), location.function_name(), location.line(), parent };
+            const auto result = table.m_children.try_emplace(key, static_cast<Node>(table.m_nodes.size()));
+
+            if (result.second)
+            {
+                table.m_nodes.push_back(NodeInfo{ parent, key.m_function });
+            }
+
+            return result.first->second;
+        }
+
+        // Statistics merged from all threads, ordered by callers, file and line
+        static Sites sites()
+        {
+            // Call tree nodes are per thread, and the same call site can be seen
+            // with different string addresses in different threads
+            typedef std::tuple<std::string, std::string, uint32_t, std::string> MergedKey;
+            std::map<MergedKey, Site> merged;
+
+            Registry& registry = Profiler::registry();
+            std::lock_guard<std::mutex> lock(registry.m_mutex);
+
+            for (const std::shared_ptr<ThreadTable>& table : registry.m_tables)
+            {
+                for (const auto& entry : table->m_sites)
+                {
+                    const Key& key = entry.first;
+                    const Counters& counters = entry.second;
+                    const std::string callers = table->callers(key.m_node);
+                    const MergedKey mergedKey(callers, key.m_file, key.m_line, key.m_function);
+                    Site& site = merged.emplace(mergedKey, Site{ callers, key.m_file, key.m_function, key.m_line, 0, 0, 0 }).first->second;
+
+                    site.m_instructions += counters.m_instructions;
+                    site.m_bytes += counters.m_bytes;
+                    site.m_nanoseconds += counters.m_nanoseconds;
+                }
+            }
+
+            Sites result;
+            result.reserve(merged.size());
+
+            for (const auto& entry : merged)
+            {
+                result.push_back(entry.second);
+            }
+
+            return result;
+        }
+
+        // Writes folded stacks, i.e. 'callers;function;file:line value' lines, suitable for flamegraph.pl
+        static void writeFolded(std::ostream& stream, Metric metric = Metric::INSTRUCTIONS)
+        {
+            for (const Site& site : sites())
+            {
+                const uint64_t value = Metric::INSTRUCTIONS == metric ? site.m_instructions
+                    : Metric::BYTES == metric ? site.m_bytes : site.m_nanoseconds;
+
+                if (0 == value)
+                {
+                    continue;
+                }
+
+                if (!site.m_callers.empty())
+                {
+                    stream << site.m_callers << ';';
+                }
+
+                stream << frameName(site.m_function) << ';' << site.m_file << ':' << site.m_line << ' ' << value << '\n';
+            }
+        }
+
+        // Clears statistics, call tree nodes are kept as CPUs may refer to them
+        static void reset()
+        {
+            Registry& registry = Profiler::registry();
+            std::lock_guard<std::mutex> lock(registry.m_mutex);
+
+            for (const std::shared_ptr<ThreadTable>& table : registry.m_tables)
+            {
+                table->m_sites.clear();
+                table->m_lastCounters = nullptr;
+            }
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        // Semicolon separates frames of folded stack, but GCC puts it into signatures of templates
+        static std::string frameName(const char* function)
+        {
+            std::string result = function;
+
+            for (char& c : result)
+            {
+                if (';' == c)
+                {
+                    c = ',';
+                }
+            }
+
+            return result;
+        }
+
+        struct Key
+        {
+            const char* m_file;
+            const char* m_function;
+            uint32_t m_line;
+            Node m_node;
+
+            bool operator==(const Key& other) const
+            {
+                return m_file == other.m_file && m_function == other.m_function
+                    && m_line == other.m_line && m_node == other.m_node;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                const std::hash<const void*> hash;
+                return hash(key.m_file) ^ (hash(key.m_function) << 1) ^ key.m_line ^ (size_t(key.m_node) << 16);
+            }
+        };
+
+        struct Counters
+        {
+            uint64_t m_instructions = 0;
+            uint64_t m_bytes = 0;
+            uint64_t m_nanoseconds = 0;
+        };
+
+        struct NodeInfo
+        {
+            Node m_parent;
+            const char* m_function; // function performed the call
+        };
+
+        struct ThreadTable
+        {
+            std::unordered_map<Key, Counters, KeyHash> m_sites;
+            Counters* m_lastCounters = nullptr;
+            Clock::time_point m_lastTime;
+
+            std::vector<NodeInfo> m_nodes = { NodeInfo{ 0, nullptr } };
+            std::unordered_map<Key, Node, KeyHash> m_children;
+
+            std::string callers(Node node) const
+            {
+                std::string result;
+
+                for (; 0 != node; node = m_nodes[node].m_parent)
+                {
+                    const std::string function = frameName(m_nodes[node].m_function);
+                    result = result.empty() ? function : function + ';' + result;
+                }
+
+                return result;
+            }
+        };
+
+        struct Registry
+        {
+            std::mutex m_mutex;
+            std::vector<std::shared_ptr<ThreadTable>> m_tables;
+        };
+
+        static Registry& registry()
+        {
+            static Registry instance;
+            return instance;
+        }
+
+        static ThreadTable& threadTable()
+        {
+            thread_local const std::shared_ptr<ThreadTable> table = []()
+            {
+                const std::shared_ptr<ThreadTable> result = std::make_shared<ThreadTable>();
+                Registry& registry = Profiler::registry();
+                std::lock_guard<std::mutex> lock(registry.m_mutex);
+                registry.m_tables.push_back(result);
+                return result;
+            }();
+
+            return *table;
+        }
+    };
+
+#endif // VX16_PROFILER
+
+    enum class R8 : byte_t
+    {
+        AL = 0,
+        AH = 1,
+        BL = 2,
+        BH = 3,
+        CL = 4,
+        CH = 5,
+        DL = 6,
+        DH = 7
+    };
+
+    enum class R16 : byte_t
+    {
+        AX = 0,
+        BX = 1,
+        CX = 2,
+        DX = 3,
+
+        BP = 4,
+        SI = 5,
+        DI = 6,
+        SP = 7,
+
+        CS = 8,
+        DS = 9,
+        SS = 10,
+        ES = 11,
+        FS = 12,
+        GS = 13,
+
+        FLAGS = 14,
+
+        COUNT
+    };
+
+    // Extended registers of 386, lower halves are R16 registers with the same index
+    enum class R32 : byte_t
+    {
+        EAX = 0,
+        EBX = 1,
+        ECX = 2,
+        EDX = 3,
+
+        EBP = 4,
+        ESI = 5,
+        EDI = 6,
+        ESP = 7,
+
+        COUNT
+    };
+
+    enum class ST : byte_t
+    {
+        ST0 = 0,
+        ST1 = 1,
+        ST2 = 2,
+        ST3 = 3,
+        ST4 = 4,
+        ST5 = 5,
+        ST6 = 6,
+        ST7 = 7
+    };
+
+    enum class FPUMode : byte_t
+    {
+        FAST,  // host double precision, control word precision and rounding affect integer stores only
+        EXACT  // software double extended precision, bit exact with x87
+    };
+
+    enum class FPURounding : byte_t
+    {
+        NEAREST = 0,
+        DOWN    = 1,
+        UP      = 2,
+        ZERO    = 3
+    };
+
+    enum class FPUOperation : byte_t
+    {
+        ADD,
+        SUB,
+        SUBR,
+        MUL,
+        DIV,
+        DIVR
+    };
+
+    enum class FPUConstant : byte_t
+    {
+        ZERO,
+        ONE,
+        PI,
+        L2T,
+        L2E,
+        LG2,
+        LN2
+    };
+
+    namespace detail
+    {
+
+        struct FPUContext
+        {
+            FPURounding m_rounding;
+            unsigned m_precision; // significand bits, 24, 53 or 64
+            word_t m_exceptions;
+        };
+
+        struct ExactArithmetic;
+        struct FastArithmetic;
+
+    } // namespace detail
+
+    class FPU
+    {
+    public:
+        static const word_t STATUS_INVALID       = 0x0001;
+        static const word_t STATUS_DENORMAL      = 0x0002;
+        static const word_t STATUS_ZERO_DIVIDE   = 0x0004;
+        static const word_t STATUS_OVERFLOW      = 0x0008;
+        static const word_t STATUS_UNDERFLOW     = 0x0010;
+        static const word_t STATUS_PRECISION     = 0x0020;
+        static const word_t STATUS_STACK_FAULT   = 0x0040;
+        static const word_t STATUS_ERROR_SUMMARY = 0x0080;
+        static const word_t STATUS_C0            = 0x0100;
+        static const word_t STATUS_C1            = 0x0200;
+        static const word_t STATUS_C2            = 0x0400;
+        static const word_t STATUS_C3            = 0x4000;
+        static const word_t STATUS_BUSY          = 0x8000;
+
+        static const word_t DEFAULT_CONTROL_WORD = 0x037F;
+
+        explicit FPU(FPUMode mode = FPUMode::FAST);
+
+        FPUMode mode() const { return m_mode; }
+
+        // Switches arithmetic mode keeping register contents
+        void setMode(FPUMode mode);
+        void init();
+
+        word_t controlWord() const { return m_control; }
+        void setControlWord(word_t value) { m_control = value; }
+
+        word_t statusWord() const;
+        word_t tagWord() const;
+        void clearExceptions();
+        bool isEmpty(ST reg) const;
+
+        // Register values for inspection, no exceptions are raised
+        double st(ST reg) const;
+        Float80 stExtended(ST reg) const;
+        void load(ST reg);
+        void loadFloat32(dword_t value);
+        void loadFloat64(qword_t value);
+        void loadFloat80(Float80 value);
+        void loadInt(int64_t value);
+        void loadConstant(FPUConstant value);
+        void store(ST reg, bool pop);
+        dword_t storeFloat32(bool pop);
+        qword_t storeFloat64(bool pop);
+        Float80 storeFloat80(bool pop);
+
+        // Returns integer indefinite value on overflow, result should be truncated to the given size
+        int64_t storeInt(unsigned bytes, bool pop);
+
+        // Register form, dst = dst op src where one of operands must be ST0
+        void arithmetic(FPUOperation operation, ST dst, ST src, bool pop);
+
+        // Memory forms, ST0 = ST0 op value
+        void arithmeticFloat32(FPUOperation operation, dword_t value);
+        void arithmeticFloat64(FPUOperation operation, qword_t value);
+        void arithmeticInt(FPUOperation operation, int64_t value);
+
+        // Sets condition codes comparing ST0 with operand, then pops the given number of times
+        void compare(ST reg, unsigned pops);
+        void compareFloat32(dword_t value, unsigned pops);
+        void compareFloat64(qword_t value, unsigned pops);
+        void test();
+        void squareRoot();
+        void roundToIntegral();
+        void abs();
+        void negate();
+        void exchange(ST reg);
+
+    private:
+        static const size_t REGISTER_COUNT = 8;
+        static const word_t TOP_MASK = 0x3800;
+        static const unsigned TOP_SHIFT = 11;
+        static const word_t EXCEPTION_MASK = 0x003F;
+        static const word_t CONDITION_MASK = STATUS_C0 | STATUS_C1 | STATUS_C2 | STATUS_C3;
+
+        FPUMode m_mode;
+        word_t m_control;
+        word_t m_status;
+        byte_t m_top;
+        byte_t m_empty; // bit per physical register
+
+        double m_fast[REGISTER_COUNT];
+        Float80 m_exact[REGISTER_COUNT];
+
+        double* registers(detail::FastArithmetic);
+        Float80* registers(detail::ExactArithmetic);
+        size_t physical(ST reg) const;
+        bool isPhysicalEmpty(size_t index) const;
+        FPURounding rounding() const;
+        detail::FPUContext context() const;
+        void raise(word_t exceptions);
+        void setConditionCodes(word_t codes);
+
+        template <typename A>
+        typename A::Value get(ST reg);
+
+        template <typename A>
+        void set(ST reg, const typename A::Value& value);
+
+        template <typename A>
+        void push(typename A::Value value);
+        void pop();
+
+        template <typename T, typename F, typename E>
+        void loadConverted(T value, E (*exact)(T, detail::FPUContext&), F (*fast)(T, detail::FPUContext&));
+
+        template <typename T>
+        T storeConverted(bool pop, T (*exact)(const Float80&, detail::FPUContext&), T (*fast)(double, detail::FPUContext&));
+
+        template <typename A>
+        int64_t storeIntImpl(unsigned bytes, bool pop);
+
+        template <typename A>
+        void arithmeticImpl(FPUOperation operation, ST dst, const typename A::Value& src);
+
+        template <typename T, typename F, typename E>
+        void arithmeticConverted(FPUOperation operation, T value, E (*exact)(T, detail::FPUContext&), F (*fast)(T, detail::FPUContext&));
+
+        template <typename A>
+        void compareImpl(const typename A::Value& rhs, unsigned pops);
+
+        template <typename T, typename F, typename E>
+        void compareConverted(T value, unsigned pops, E (*exact)(T, detail::FPUContext&), F (*fast)(T, detail::FPUContext&));
+
+        template <typename A, typename F>
+        void unaryImpl(F function);
+
+        template <typename A>
+        void exchangeImpl(ST reg);
+    };
+
+#ifdef VX16_INCLUDE_IMPLEMENTATION
+
+    namespace detail
+    {
+
+        struct UInt128
+        {
+            qword_t m_high;
+            qword_t m_low;
+        };
+
+        inline bool isZero(const UInt128& value)
+        {
+            return 0 == (value.m_high | value.m_low);
+        }
+
+        inline bool isEqual(const UInt128& lhs, const UInt128& rhs)
+        {
+            return lhs.m_high == rhs.m_high && lhs.m_low == rhs.m_low;
+        }
+
+        inline bool isLess(const UInt128& lhs, const UInt128& rhs)
+        {
+            return lhs.m_high < rhs.m_high || (lhs.m_high == rhs.m_high && lhs.m_low < rhs.m_low);
+        }
+
+        inline UInt128 add(const UInt128& lhs, const UInt128& rhs)
+        {
+            const qword_t low = lhs.m_low + rhs.m_low;
+            return UInt128{ lhs.m_high + rhs.m_high + (low < lhs.m_low), low };
+        }
+
+        inline UInt128 subtract(const UInt128& lhs, const UInt128& rhs)
+        {
+            return UInt128{ lhs.m_high - rhs.m_high - (lhs.m_low < rhs.m_low), lhs.m_low - rhs.m_low };
+        }
+
+        inline UInt128 shiftLeft(const UInt128& value, unsigned count)
+        {
+            return 0 == count ? value
+                : count >= 128 ? UInt128{ 0, 0 }
+                : count >= 64 ? UInt128{ value.m_low << (count - 64), 0 }
+                : UInt128{ (value.m_high << count) | (value.m_low >> (64 - count)), value.m_low << count };
+        }
+
+        inline UInt128 shiftRight(const UInt128& value, unsigned count)
+        {
+            return 0 == count ? value
+                : count >= 128 ? UInt128{ 0, 0 }
+                : count >= 64 ? UInt128{ 0, value.m_high >> (count - 64) }
+                : UInt128{ value.m_high >> count, (value.m_low >> count) | (value.m_high << (64 - count)) };
+        }
+
+        // Shifts right, and sets the lowest bit if any of shifted out bits was set
+        inline UInt128 shiftRightSticky(const UInt128& value, unsigned count)
+        {
+            UInt128 result = shiftRight(value, count);
+
+            if (!isEqual(value, shiftLeft(result, count)))
+            {
+                result.m_low |= 1;
+            }
+
+            return result;
+        }
+
+        inline UInt128 multiply(qword_t lhs, qword_t rhs)
+        {
+            const qword_t mask = 0xFFFFFFFF;
+            const qword_t ll = (lhs & mask) * (rhs & mask);
+            const qword_t lh = (lhs & mask) * (rhs >> 32);
+            const qword_t hl = (lhs >> 32) * (rhs & mask);
+            const qword_t hh = (lhs >> 32) * (rhs >> 32);
+            const qword_t middle = (ll >> 32) + (lh & mask) + (hl & mask);
+
+            return UInt128{ hh + (lh >> 32) + (hl >> 32) + (middle >> 32), (middle << 32) | (ll & mask) };
+        }
+
+        inline unsigned leadingZeros(qword_t value)
+        {
+#ifdef __GNUC__
+            return 0 == value ? 64 : static_cast<unsigned>(__builtin_clzll(value));
+#else // !__GNUC__
+            unsigned count = 0;
+
+            for (; count < 64 && 0 == (value >> 63); ++count)
+            {
+                value <<= 1;
+            }
+
+            return count;
+#endif // __GNUC__
+        }
+
+        inline unsigned leadingZeros(const UInt128& value)
+        {
+            return 0 != value.m_high ? leadingZeros(value.m_high) : 64 + leadingZeros(value.m_low);
+        }
+
+        // Status word exception bits, see FPU class
+        VX16_CONSTANT word_t FPU_INVALID     = 0x0001;
+        VX16_CONSTANT word_t FPU_ZERO_DIVIDE = 0x0004;
+        VX16_CONSTANT word_t FPU_OVERFLOW    = 0x0008;
+        VX16_CONSTANT word_t FPU_UNDERFLOW   = 0x0010;
+        VX16_CONSTANT word_t FPU_PRECISION   = 0x0020;
+
+        // Finite non-zero value, equal to significand / 2^126 * 2^exponent
+        // The leading bit of normalized significand is bit 126, bit 127 is used for carry
+        struct Unpacked
+        {
+            bool m_sign;
+            int32_t m_exponent;
+            UInt128 m_significand;
+        };
+
+        // Rounded value in a particular format, significand has integer bit at (precision - 1)
+        struct Packed
+        {
+            bool m_sign;
+            int32_t m_exponent; // biased
+            qword_t m_significand;
+        };
+
+        VX16_CONSTANT int32_t FLOAT80_BIAS = 16383;
+        VX16_CONSTANT int32_t FLOAT80_MAX_EXPONENT = 0x7FFF;
+        VX16_CONSTANT qword_t FLOAT80_INTEGER_BIT = qword_t(1) << 63;
+        VX16_CONSTANT qword_t FLOAT80_QUIET_BIT = qword_t(1) << 62;
+
+        inline Float80 makeFloat80(bool sign, int32_t exponent, qword_t significand)
+        {
+            return Float80{ significand, word_t((sign ? 0x8000 : 0) | exponent) };
+        }
+
+        inline bool sign(const Float80& value)
+        {
+            return 0 != (value.m_signExponent & 0x8000);
+        }
+
+        inline int32_t exponent(const Float80& value)
+        {
+            return value.m_signExponent & 0x7FFF;
+        }
+
+        inline bool isNaN(const Float80& value)
+        {
+            return FLOAT80_MAX_EXPONENT == exponent(value) && 0 != (value.m_significand << 1);
+        }
+
+        inline bool isInfinity(const Float80& value)
+        {
+            return FLOAT80_MAX_EXPONENT == exponent(value) && 0 == (value.m_significand << 1);
+        }
+
+        inline bool isZero(const Float80& value)
+        {
+            return 0 == exponent(value) && 0 == value.m_significand;
+        }
+
+        inline bool isSignaling(const Float80& value)
+        {
+            return isNaN(value) && 0 == (value.m_significand & FLOAT80_QUIET_BIT);
+        }
+
+        inline Float80 indefinite()
+        {
+            return makeFloat80(true, FLOAT80_MAX_EXPONENT, FLOAT80_INTEGER_BIT | FLOAT80_QUIET_BIT);
+        }
+
+        inline Float80 infinity(bool sign)
+        {
+            return makeFloat80(sign, FLOAT80_MAX_EXPONENT, FLOAT80_INTEGER_BIT);
+        }
+
+        inline Float80 zero(bool sign)
+        {
+            return makeFloat80(sign, 0, 0);
+        }
+
+        inline Float80 quiet(const Float80& value)
+        {
+            return Float80{ value.m_significand | FLOAT80_INTEGER_BIT | FLOAT80_QUIET_BIT, value.m_signExponent };
+        }
+
+        inline void normalize(Unpacked& value)
+        {
+            if (0 != (value.m_significand.m_high >> 63))
+            {
+                value.m_significand = shiftRightSticky(value.m_significand, 1);
+                ++value.m_exponent;
+            }
+            else
+            {
+                const unsigned shift = leadingZeros(value.m_significand) - 1;
+                value.m_significand = shiftLeft(value.m_significand, shift);
+                value.m_exponent -= static_cast<int32_t>(shift);
+            }
+        }
+
+        // Value must be finite and non-zero
+        inline Unpacked unpack(const Float80& value)
+        {
+            const int32_t biased = exponent(value);
+            Unpacked result = { sign(value), (0 == biased ? 1 : biased) - FLOAT80_BIAS,
+                shiftLeft(UInt128{ 0, value.m_significand }, 63) };
+            normalize(result);
+            return result;
+        }
+
+        // Value significand must be normalized
+        inline Packed round(Unpacked value, unsigned precision, int32_t bias, int32_t maxExponent, FPUContext& context)
+        {
+            int32_t biased = value.m_exponent + bias;
+            bool tiny = false;
+
+            if (biased <= 0)
+            {
+                tiny = true;
+                value.m_significand = shiftRightSticky(value.m_significand, static_cast<unsigned>(std::min(1 - biased, 128)));
+                biased = 1;
+            }
+
+            const unsigned lsbPosition = 127 - precision;
+            const UInt128 lsb = shiftLeft(UInt128{ 0, 1 }, lsbPosition);
+            const UInt128 lowMask = subtract(lsb, UInt128{ 0, 1 });
+            const UInt128 remainder = { value.m_significand.m_high & lowMask.m_high, value.m_significand.m_low & lowMask.m_low };
+            const UInt128 half = shiftRight(lsb, 1);
+
+            UInt128 significand = { value.m_significand.m_high & ~lowMask.m_high, value.m_significand.m_low & ~lowMask.m_low };
+            bool increment = false;
+
+            switch (context.m_rounding)
+            {
+            case FPURounding::NEAREST:
+                increment = isLess(half, remainder)
+                    || (isEqual(half, remainder) && 0 != ((significand.m_high & lsb.m_high) | (significand.m_low & lsb.m_low)));
+                break;
+
+            case FPURounding::DOWN:
+                increment = value.m_sign && !isZero(remainder);
+                break;
+
+            case FPURounding::UP:
+                increment = !value.m_sign && !isZero(remainder);
+                break;
+
+            case FPURounding::ZERO:
+                break;
+            }
+
+            if (increment)
+            {
+                significand = add(significand, lsb);
+
+                if (0 != (significand.m_high >> 63))
+                {
+                    significand = shiftRight(significand, 1);
+                    ++biased;
+                }
+            }
+
+            if (!isZero(remainder))
+            {
+                context.m_exceptions |= tiny ? FPU_PRECISION | FPU_UNDERFLOW : FPU_PRECISION;
+            }
+
+            if (tiny && 0 == (significand.m_high >> 62))
+            {
+                biased = 0;
+            }
+
+            if (biased >= maxExponent)
+            {
+                context.m_exceptions |= FPU_OVERFLOW | FPU_PRECISION;
+
+                const bool toInfinity = FPURounding::NEAREST == context.m_rounding
+                    || (FPURounding::UP == context.m_rounding && !value.m_sign)
+                    || (FPURounding::DOWN == context.m_rounding && value.m_sign);
+                const qword_t integerBit = qword_t(1) << (precision - 1);
+
+                return toInfinity
+                    ? Packed{ value.m_sign, maxExponent, integerBit }
+                    : Packed{ value.m_sign, maxExponent - 1, integerBit | (integerBit - 1) };
+            }
+
+            return Packed{ value.m_sign, biased, shiftRight(significand, lsbPosition).m_low };
+        }
+
+        inline Float80 roundFloat80(const Unpacked& value, FPUContext& context)
+        {
+            const Packed packed = round(value, context.m_precision, FLOAT80_BIAS, FLOAT80_MAX_EXPONENT, context);
+            return makeFloat80(packed.m_sign, packed.m_exponent, packed.m_significand << (64 - context.m_precision));
+        }
+
+        // Conversion from IEEE single or double precision with the given significand and exponent sizes
+        template <typename T, unsigned SIGNIFICAND_BITS, unsigned EXPONENT_BITS>
+        Float80 fromIEEE(T bits, FPUContext& context)
+        {
+            const int32_t maxExponent = (1 << EXPONENT_BITS) - 1;
+            const int32_t bias = maxExponent >> 1;
+            const bool sign = 0 != (bits >> (SIGNIFICAND_BITS + EXPONENT_BITS));
+            const int32_t biased = static_cast<int32_t>((bits >> SIGNIFICAND_BITS) & maxExponent);
+            const qword_t fraction = bits & ((T(1) << SIGNIFICAND_BITS) - 1);
+
+            if (maxExponent == biased)
+            {
+                if (0 == fraction)
+                {
+                    return infinity(sign);
+                }
+
+                const Float80 nan = makeFloat80(sign, FLOAT80_MAX_EXPONENT, FLOAT80_INTEGER_BIT | (fraction << (63 - SIGNIFICAND_BITS)));
+
+                if (isSignaling(nan))
+                {
+                    context.m_exceptions |= FPU_INVALID;
+                }
+
+                return quiet(nan);
+            }
+
+            if (0 == biased && 0 == fraction)
+            {
+                return zero(sign);
+            }
+
+            Unpacked value = { sign, 0 == biased ? 1 - bias : biased - bias,
+                shiftLeft(UInt128{ 0, 0 == biased ? fraction : fraction | (qword_t(1) << SIGNIFICAND_BITS) }, 126 - SIGNIFICAND_BITS) };
+            normalize(value);
+
+            FPUContext exact = { FPURounding::NEAREST, 64, 0 };
+            return roundFloat80(value, exact);
+        }
+
+        template <typename T, unsigned SIGNIFICAND_BITS, unsigned EXPONENT_BITS>
+        T toIEEE(const Float80& value, FPUContext& context)
+        {
+            const int32_t maxExponent = (1 << EXPONENT_BITS) - 1;
+            const int32_t bias = maxExponent >> 1;
+            const T signBit = T(sign(value)) << (SIGNIFICAND_BITS + EXPONENT_BITS);
+            const T infinityBits = T(maxExponent) << SIGNIFICAND_BITS;
+
+            if (isNaN(value))
+            {
+                if (isSignaling(value))
+                {
+                    context.m_exceptions |= FPU_INVALID;
+                }
+
+                const T quietBit = T(1) << (SIGNIFICAND_BITS - 1);
+                return signBit | infinityBits | quietBit | T((value.m_significand << 1) >> (64 - SIGNIFICAND_BITS));
+            }
+
+            if (isInfinity(value))
+            {
+                return signBit | infinityBits;
+            }
+
+            if (isZero(value))
+            {
+                return signBit;
+            }
+
+            FPUContext target = { context.m_rounding, SIGNIFICAND_BITS + 1, 0 };
+            const Packed packed = round(unpack(value), SIGNIFICAND_BITS + 1, bias, maxExponent, target);
+            context.m_exceptions |= target.m_exceptions;
+
+            return signBit | (T(packed.m_exponent) << SIGNIFICAND_BITS) | (T(packed.m_significand) & ((T(1) << SIGNIFICAND_BITS) - 1));
+        }
+
+        inline Float80 fromMagnitude(bool sign, qword_t magnitude)
+        {
+            if (0 == magnitude)
+            {
+                return zero(sign);
+            }
+
+            Unpacked unpacked = { sign, 126, UInt128{ 0, magnitude } };
+            normalize(unpacked);
+
+            FPUContext exact = { FPURounding::NEAREST, 64, 0 };
+            return roundFloat80(unpacked, exact);
+        }
+
+        inline Float80 fromInt(int64_t value)
+        {
+            return fromMagnitude(value < 0, value < 0 ? 0 - qword_t(value) : qword_t(value));
+        }
+
+        // Result of operation with at least one NaN operand
+        inline Float80 propagateNaN(const Float80& lhs, const Float80& rhs, FPUContext& context)
+        {
+            if (isSignaling(lhs) || isSignaling(rhs))
+            {
+                context.m_exceptions |= FPU_INVALID;
+            }
+
+            if (isNaN(lhs) && isNaN(rhs))
+            {
+                if (isSignaling(lhs) != isSignaling(rhs))
+                {
+                    return isSignaling(lhs) ? rhs : lhs;
+                }
+
+                return quiet((lhs.m_significand << 1) < (rhs.m_significand << 1) ? rhs : lhs);
+            }
+
+            return quiet(isNaN(lhs) ? lhs : rhs);
+        }
+
+        inline Float80 invalid(FPUContext& context)
+        {
+            context.m_exceptions |= FPU_INVALID;
+            return indefinite();
+        }
+
+        // Rounds to integer according to rounding control, returns false if magnitude doesn't fit into 64 bits
+        inline bool roundToInteger(const Float80& value, FPUContext& context, qword_t& magnitude)
+        {
+            const Unpacked unpacked = unpack(value);
+
+            if (unpacked.m_exponent >= 64)
+            {
+                return false;
+            }
+
+            const unsigned shift = static_cast<unsigned>(126 - unpacked.m_exponent);
+            const UInt128 integer = shiftRight(unpacked.m_significand, shift);
+            const UInt128 fraction = shift >= 128 ? UInt128{ 0, 1 } : shiftLeft(unpacked.m_significand, 128 - shift);
+            const UInt128 half = { qword_t(1) << 63, 0 };
+
+            bool increment = false;
+
+            switch (context.m_rounding)
+            {
+            case FPURounding::NEAREST:
+                increment = isLess(half, fraction) || (isEqual(half, fraction) && 0 != (integer.m_low & 1));
+                break;
+
+            case FPURounding::DOWN:
+                increment = unpacked.m_sign && !isZero(fraction);
+                break;
+
+            case FPURounding::UP:
+                increment = !unpacked.m_sign && !isZero(fraction);
+                break;
+
+            case FPURounding::ZERO:
+                break;
+            }
+
+            if (!isZero(fraction))
+            {
+                context.m_exceptions |= FPU_PRECISION;
+            }
+
+            magnitude = integer.m_low + increment;
+            return !(increment && 0 == magnitude);
+        }
+
+        inline bool toInt(const Float80& value, unsigned bytes, FPUContext& context, int64_t& result)
+        {
+            if (isZero(value))
+            {
+                result = 0;
+                return true;
+            }
+
+            qword_t magnitude = 0;
+
+            if (isNaN(value) || isInfinity(value) || !roundToInteger(value, context, magnitude))
+            {
+                return false;
+            }
+
+            const qword_t limit = qword_t(1) << (bytes * 8 - 1);
+
+            if (magnitude > limit || (magnitude == limit && !sign(value)))
+            {
+                return false;
+            }
+
+            result = static_cast<int64_t>(sign(value) ? 0 - magnitude : magnitude);
+            return true;
+        }
+
+        inline Float80 roundToIntegral(const Float80& value, FPUContext& context)
+        {
+            if (isNaN(value))
+            {
+                return propagateNaN(value, value, context);
+            }
+
+            if (isInfinity(value) || isZero(value) || unpack(value).m_exponent >= 63)
+            {
+                return value;
+            }
+
+            qword_t magnitude = 0;
+            roundToInteger(value, context, magnitude);
+
+            return fromMagnitude(sign(value), magnitude);
+        }
+
+        inline Float80 add(const Float80& lhs, const Float80& rhs, bool negate, FPUContext& context)
+        {
+            if (isNaN(lhs) || isNaN(rhs))
+            {
+                return propagateNaN(lhs, rhs, context);
+            }
+
+            const bool rhsSign = sign(rhs) != negate;
+
+            if (isInfinity(lhs) || isInfinity(rhs))
+            {
+                if (isInfinity(lhs) && isInfinity(rhs) && sign(lhs) != rhsSign)
+                {
+                    return invalid(context);
+                }
+
+                return isInfinity(lhs) ? lhs : infinity(rhsSign);
+            }
+
+            if (isZero(lhs) && isZero(rhs))
+            {
+                return zero(sign(lhs) == rhsSign ? rhsSign : FPURounding::DOWN == context.m_rounding);
+            }
+
+            if (isZero(rhs))
+            {
+                return roundFloat80(unpack(lhs), context);
+            }
+
+            if (isZero(lhs))
+            {
+                Unpacked value = unpack(rhs);
+                value.m_sign = rhsSign;
+                return roundFloat80(value, context);
+            }
+
+            Unpacked larger = unpack(lhs);
+            Unpacked smaller = unpack(rhs);
+            smaller.m_sign = rhsSign;
+
+            if (larger.m_exponent < smaller.m_exponent
+                || (larger.m_exponent == smaller.m_exponent && isLess(larger.m_significand, smaller.m_significand)))
+            {
+                std::swap(larger, smaller);
+            }
+
+            smaller.m_significand = shiftRightSticky(smaller.m_significand,
+                static_cast<unsigned>(std::min(larger.m_exponent - smaller.m_exponent, 128)));
+
+            if (larger.m_sign == smaller.m_sign)
+            {
+                larger.m_significand = add(larger.m_significand, smaller.m_significand);
+            }
+            else
+            {
+                larger.m_significand = subtract(larger.m_significand, smaller.m_significand);
+
+                if (isZero(larger.m_significand))
+                {
+                    return zero(FPURounding::DOWN == context.m_rounding);
+                }
+            }
+
+            normalize(larger);
+            return roundFloat80(larger, context);
+        }
+
+        inline Float80 multiply(const Float80& lhs, const Float80& rhs, FPUContext& context)
+        {
+            if (isNaN(lhs) || isNaN(rhs))
+            {
+                return propagateNaN(lhs, rhs, context);
+            }
+
+            const bool resultSign = sign(lhs) != sign(rhs);
+
+            if (isInfinity(lhs) || isInfinity(rhs))
+            {
+                return isZero(lhs) || isZero(rhs) ? invalid(context) : infinity(resultSign);
+            }
+
+            if (isZero(lhs) || isZero(rhs))
+            {
+                return zero(resultSign);
+            }
+
+            const Unpacked left = unpack(lhs);
+            const Unpacked right = unpack(rhs);
+            Unpacked result = { resultSign, left.m_exponent + right.m_exponent,
+                multiply(shiftRight(left.m_significand, 63).m_low, shiftRight(right.m_significand, 63).m_low) };
+
+            normalize(result);
+            return roundFloat80(result, context);
+        }
+
+        inline Float80 divide(const Float80& lhs, const Float80& rhs, FPUContext& context)
+        {
+            if (isNaN(lhs) || isNaN(rhs))
+            {
+                return propagateNaN(lhs, rhs, context);
+            }
+
+            const bool resultSign = sign(lhs) != sign(rhs);
+
+            if (isInfinity(lhs))
+            {
+                return isInfinity(rhs) ? invalid(context) : infinity(resultSign);
+            }
+
+            if (isInfinity(rhs))
+            {
+                return zero(resultSign);
+            }
+
+            if (isZero(rhs))
+            {
+                if (isZero(lhs))
+                {
+                    return invalid(context);
+                }
+
+                context.m_exceptions |= FPU_ZERO_DIVIDE;
+                return infinity(resultSign);
+            }
+
+            if (isZero(lhs))
+            {
+                return zero(resultSign);
+            }
+
+            const Unpacked left = unpack(lhs);
+            const Unpacked right = unpack(rhs);
+            const UInt128 divisor = shiftRight(right.m_significand, 63);
+
+            UInt128 remainder = shiftRight(left.m_significand, 63);
+            UInt128 quotient = { 0, 0 };
+
+            for (int bit = 126; bit >= 0; --bit)
+            {
+                if (!isLess(remainder, divisor))
+                {
+                    remainder = subtract(remainder, divisor);
+                    quotient = add(quotient, shiftLeft(UInt128{ 0, 1 }, static_cast<unsigned>(bit)));
+                }
+
+                remainder = shiftLeft(remainder, 1);
+            }
+
+            if (!isZero(remainder))
+            {
+                quotient.m_low |= 1;
+            }
+
+            Unpacked result = { resultSign, left.m_exponent - right.m_exponent, quotient };
+            normalize(result);
+            return roundFloat80(result, context);
+        }
+
+        inline Float80 squareRoot(const Float80& value, FPUContext& context)
+        {
+            if (isNaN(value))
+            {
+                return propagateNaN(value, value, context);
+            }
+
+            if (isZero(value))
+            {
+                return value;
+            }
+
+            if (sign(value))
+            {
+                return invalid(context);
+            }
+
+            if (isInfinity(value))
+            {
+                return value;
+            }
+
+            // Digit by digit calculation of 68 bits of root, radicand is 2 or 4 times significand
+            // so its exponent becomes even, and the root is in [2^32, 2^33) after the first 33 steps
+            const Unpacked unpacked = unpack(value);
+            const int32_t exponent = unpacked.m_exponent;
+            const UInt128 radicand = shiftLeft(shiftRight(unpacked.m_significand, 63), 0 == (exponent & 1) ? 1 : 2);
+
+            UInt128 root = { 0, 0 };
+            UInt128 remainder = { 0, 0 };
+
+            for (unsigned step = 0; step < 68; ++step)
+            {
+                const qword_t digits = step < 33 ? shiftRight(radicand, 64 - 2 * step).m_low & 3 : 0;
+                remainder = shiftLeft(remainder, 2);
+                remainder.m_low |= digits;
+
+                const UInt128 trial = { (root.m_high << 2) | (root.m_low >> 62), (root.m_low << 2) | 1 };
+                root = shiftLeft(root, 1);
+
+                if (!isLess(remainder, trial))
+                {
+                    remainder = subtract(remainder, trial);
+                    root.m_low |= 1;
+                }
+            }
+
+            Unpacked result = { false, exponent >= 0 ? exponent / 2 : -((1 - exponent) / 2), shiftLeft(root, 59) };
+
+            if (!isZero(remainder))
+            {
+                result.m_significand.m_low |= 1;
+            }
+
+            normalize(result);
+            return roundFloat80(result, context);
+        }
+
+        // Returns negative, zero or positive value for less, equal and greater respectively
+        // Operands must not be NaNs
+        inline int compare(const Float80& lhs, const Float80& rhs)
+        {
+            if (isZero(lhs) && isZero(rhs))
+            {
+                return 0;
+            }
+
+            const bool lhsSign = sign(lhs);
+
+            if (lhsSign != sign(rhs))
+            {
+                return lhsSign ? -1 : 1;
+            }
+
+            // Compare magnitudes using normalized exponent and significand
+            const auto magnitude = [](const Float80& value, int32_t& exponent, qword_t& significand)
+            {
+                if (isZero(value))
+                {
+                    exponent = INT32_MIN;
+                    significand = 0;
+                }
+                else if (isInfinity(value))
+                {
+                    exponent = INT32_MAX;
+                    significand = 0;
+                }
+                else
+                {
+                    const Unpacked unpacked = unpack(value);
+                    exponent = unpacked.m_exponent;
+                    significand = shiftRight(unpacked.m_significand, 63).m_low;
+                }
+            };
+
+            int32_t lhsExponent, rhsExponent;
+            qword_t lhsSignificand, rhsSignificand;
+            magnitude(lhs, lhsExponent, lhsSignificand);
+            magnitude(rhs, rhsExponent, rhsSignificand);
+
+            const int order = lhsExponent != rhsExponent ? (lhsExponent < rhsExponent ? -1 : 1)
+                : lhsSignificand != rhsSignificand ? (lhsSignificand < rhsSignificand ? -1 : 1) : 0;
+
+            return lhsSign ? -order : order;
+        }
+
+        inline Float80 constant(FPUConstant value, FPURounding rounding)
+        {
+            if (FPUConstant::ZERO == value)
+            {
+                return zero(false);
+            }
+
+            // Constants with 128 bits of significand, rounded to 64 bits according to rounding control
+            static const UInt128 SIGNIFICANDS[] =
+            {
+                { 0,                     0                     },
+                { 0x8000000000000000ull, 0                     },
+                { 0xC90FDAA22168C234ull, 0xC4C6628B80DC1CD1ull }, // pi
+                { 0xD49A784BCD1B8AFEull, 0x492BF6FF4DAFDB4Cull }, // log2(10)
+                { 0xB8AA3B295C17F0BBull, 0xBE87FED0691D3E88ull }, // log2(e)
+                { 0x9A209A84FBCFF798ull, 0x8F8959AC0B7C9178ull }, // log10(2)
+                { 0xB17217F7D1CF79ABull, 0xC9E3B39803F2F6AFull }, // ln(2)
+            };
+            static const int32_t EXPONENTS[] = { 0, 0, 1, 1, 0, -2, -1 };
+
+            const size_t index = static_cast<size_t>(value);
+            const Unpacked unpacked = { false, EXPONENTS[index], shiftRightSticky(SIGNIFICANDS[index], 1) };
+
+            FPUContext context = { rounding, 64, 0 };
+            return roundFloat80(unpacked, context);
+        }
+
+    } // namespace detail
+
+    namespace detail
+    {
+
+        // Software double extended precision, x87 compatible including rounding and NaN propagation
+        struct ExactArithmetic
+        {
+            typedef Float80 Value;
+
+            static Value fromFloat32(dword_t bits, FPUContext& context)
+            {
+                return fromIEEE<dword_t, 23, 8>(bits, context);
+            }
+
+            static Value fromFloat64(qword_t bits, FPUContext& context)
+            {
+                return fromIEEE<qword_t, 52, 11>(bits, context);
+            }
+
+            // Loading of double extended value never raises, even for signaling NaN
+            static Value fromFloat80(const Float80& value, FPUContext&)
+            {
+                return value;
+            }
+
+            static Value fromInt(int64_t value)
+            {
+                return detail::fromInt(value);
+            }
+
+            static dword_t toFloat32(const Value& value, FPUContext& context)
+            {
+                return toIEEE<dword_t, 23, 8>(value, context);
+            }
+
+            static qword_t toFloat64(const Value& value, FPUContext& context)
+            {
+                return toIEEE<qword_t, 52, 11>(value, context);
+            }
+
+            static Float80 toFloat80(const Value& value, FPUContext&)
+            {
+                return value;
+            }
+
+            static bool toInt(const Value& value, unsigned bytes, FPUContext& context, int64_t& result)
+            {
+                return detail::toInt(value, bytes, context, result);
+            }
+
+            static Value add(const Value& lhs, const Value& rhs, FPUContext& context)
+            {
+                return detail::add(lhs, rhs, false, context);
+            }
+
+            static Value subtract(const Value& lhs, const Value& rhs, FPUContext& context)
+            {
+                return detail::add(lhs, rhs, true, context);
+            }
+
+            static Value multiply(const Value& lhs, const Value& rhs, FPUContext& context)
+            {
+                return detail::multiply(lhs, rhs, context);
+            }
+
+            static Value divide(const Value& lhs, const Value& rhs, FPUContext& context)
+            {
+                return detail::divide(lhs, rhs, context);
+            }
+
+            static Value squareRoot(const Value& value, FPUContext& context)
+            {
+                return detail::squareRoot(value, context);
+            }
+
+            static Value roundToIntegral(const Value& value, FPUContext& context)
+            {
+                return detail::roundToIntegral(value, context);
+            }
+
+            static Value negate(const Value& value)
+            {
+                return Float80{ value.m_significand, word_t(value.m_signExponent ^ 0x8000) };
+            }
+
+            static Value abs(const Value& value)
+            {
+                return Float80{ value.m_significand, word_t(value.m_signExponent & 0x7FFF) };
+            }
+
+            static bool isNaN(const Value& value)
+            {
+                return detail::isNaN(value);
+            }
+
+            static int compare(const Value& lhs, const Value& rhs)
+            {
+                return detail::compare(lhs, rhs);
+            }
+
+            static Value constant(FPUConstant value, FPURounding rounding)
+            {
+                return detail::constant(value, rounding);
+            }
+
+            static Value indefinite()
+            {
+                return detail::indefinite();
+            }
+
+            // Tag word value, i.e. 0 for valid, 1 for zero, 2 for special
+            static word_t tag(const Value& value)
+            {
+                return isZero(value) ? 1
+                    : FLOAT80_MAX_EXPONENT == exponent(value) || 0 == exponent(value) || 0 == (value.m_significand >> 63) ? 2 : 0;
+            }
+        };
+
+        // Host double precision, fast but not bit exact
+        struct FastArithmetic
+        {
+            typedef double Value;
+
+            static qword_t bits(Value value)
+            {
+                qword_t result;
+                memcpy(&result, &value, sizeof result);
+                return result;
+            }
+
+            static Value fromBits(qword_t bits)
+            {
+                Value result;
+                memcpy(&result, &bits, sizeof result);
+                return result;
+            }
+
+            static Value fromFloat32(dword_t bits, FPUContext&)
+            {
+                float result;
+                memcpy(&result, &bits, sizeof result);
+                return result;
+            }
+
+            static Value fromFloat64(qword_t bits, FPUContext&)
+            {
+                return fromBits(bits);
+            }
+
+            static Value fromFloat80(const Float80& value, FPUContext& context)
+            {
+                FPUContext nearest = { FPURounding::NEAREST, 64, 0 };
+                const qword_t result = toIEEE<qword_t, 52, 11>(value, nearest);
+                context.m_exceptions |= nearest.m_exceptions & FPU_INVALID;
+                return fromBits(result);
+            }
+
+            static Value fromInt(int64_t value)
+            {
+                return static_cast<Value>(value);
+            }
+
+            static dword_t toFloat32(Value value, FPUContext&)
+            {
+                const float single = static_cast<float>(value);
+                dword_t result;
+                memcpy(&result, &single, sizeof result);
+                return result;
+            }
+
+            static qword_t toFloat64(Value value, FPUContext&)
+            {
+                return bits(value);
+            }
+
+            static Float80 toFloat80(Value value, FPUContext& context)
+            {
+                return fromIEEE<qword_t, 52, 11>(bits(value), context);
+            }
+
+            static bool toInt(Value value, unsigned bytes, FPUContext& context, int64_t& result)
+            {
+                if (std::isnan(value))
+                {
+                    return false;
+                }
+
+                const Value rounded = roundToIntegral(value, context);
+                const Value limit = std::ldexp(1.0, static_cast<int>(bytes * 8 - 1));
+
+                if (rounded >= limit || rounded < -limit)
+                {
+                    return false;
+                }
+
+                result = static_cast<int64_t>(rounded);
+                return true;
+            }
+
+            static Value add(Value lhs, Value rhs, FPUContext& context)
+            {
+                return checkInvalid(lhs + rhs, lhs, rhs, context);
+            }
+
+            static Value subtract(Value lhs, Value rhs, FPUContext& context)
+            {
+                return checkInvalid(lhs - rhs, lhs, rhs, context);
+            }
+
+            static Value multiply(Value lhs, Value rhs, FPUContext& context)
+            {
+                return checkInvalid(lhs * rhs, lhs, rhs, context);
+            }
+
+            static Value divide(Value lhs, Value rhs, FPUContext& context)
+            {
+                if (0 == rhs && 0 != lhs && std::isfinite(lhs))
+                {
+                    context.m_exceptions |= FPU_ZERO_DIVIDE;
+                }
+
+                return checkInvalid(lhs / rhs, lhs, rhs, context);
+            }
+
+            static Value squareRoot(Value value, FPUContext& context)
+            {
+                return checkInvalid(std::sqrt(value), value, value, context);
+            }
+
+            static Value roundToIntegral(Value value, FPUContext& context)
+            {
+                Value result = value;
+
+                switch (context.m_rounding)
+                {
+                case FPURounding::NEAREST: result = std::nearbyint(value); break;
+                case FPURounding::DOWN:    result = std::floor(value); break;
+                case FPURounding::UP:      result = std::ceil(value); break;
+                case FPURounding::ZERO:    result = std::trunc(value); break;
+                }
+
+                if (result != value && !std::isnan(value))
+                {
+                    context.m_exceptions |= FPU_PRECISION;
+                }
+
+                return result;
+            }
+
+            static Value negate(Value value)
+            {
+                return -value;
+            }
+
+            static Value abs(Value value)
+            {
+                return std::fabs(value);
+            }
+
+            static bool isNaN(Value value)
+            {
+                return std::isnan(value);
+            }
+
+            static int compare(Value lhs, Value rhs)
+            {
+                return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+            }
+
+            static Value constant(FPUConstant value, FPURounding rounding)
+            {
+                FPUContext context = { rounding, 64, 0 };
+                return fromFloat80(detail::constant(value, rounding), context);
+            }
+
+            static Value indefinite()
+            {
+                return fromBits(0xFFF8000000000000ull);
+            }
+
+            static word_t tag(Value value)
+            {
+                return 0 == value ? 1 : std::isnormal(value) ? 0 : 2;
+            }
+
+        private:
+            static Value checkInvalid(Value result, Value lhs, Value rhs, FPUContext& context)
+            {
+                if (std::isnan(result) && !std::isnan(lhs) && !std::isnan(rhs))
+                {
+                    context.m_exceptions |= FPU_INVALID;
+                }
+
+                return result;
+            }
+        };
+
+    } // namespace detail
+
+    VX16_INLINE FPU::FPU(FPUMode mode)
+    : m_mode(mode)
+    {
+        init();
+    }
+
+    VX16_INLINE void FPU::setMode(FPUMode mode)
+    {
+        if (mode == m_mode)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < REGISTER_COUNT; ++i)
+        {
+            detail::FPUContext context = { FPURounding::NEAREST, 64, 0 };
+
+            if (FPUMode::EXACT == mode)
+            {
+                m_exact[i] = detail::FastArithmetic::toFloat80(m_fast[i], context);
+            }
+            else
+            {
+                m_fast[i] = detail::FastArithmetic::fromFloat80(m_exact[i], context);
+            }
+        }
+
+        m_mode = mode;
+    }
+
+    VX16_INLINE void FPU::init()
+    {
+        m_control = DEFAULT_CONTROL_WORD;
+        m_status = 0;
+        m_top = 0;
+        m_empty = 0xFF;
+
+        for (size_t i = 0; i < REGISTER_COUNT; ++i)
+        {
+            m_fast[i] = 0;
+            m_exact[i] = Float80{ 0, 0 };
+        }
+    }
+
+    VX16_INLINE word_t FPU::statusWord() const
+    {
+        return word_t((m_status & ~TOP_MASK) | (m_top << TOP_SHIFT));
+    }
+
+    VX16_INLINE word_t FPU::tagWord() const
+    {
+        word_t result = 0;
+
+        for (size_t i = 0; i < REGISTER_COUNT; ++i)
+        {
+            const word_t tag = isPhysicalEmpty(i) ? 3
+                : FPUMode::EXACT == m_mode ? detail::ExactArithmetic::tag(m_exact[i]) : detail::FastArithmetic::tag(m_fast[i]);
+            result |= tag << (i * 2);
+        }
+
+        return result;
+    }
+
+    VX16_INLINE void FPU::clearExceptions()
+    {
+        m_status &= ~(STATUS_BUSY | STATUS_ERROR_SUMMARY | STATUS_STACK_FAULT | EXCEPTION_MASK);
+    }
+
+    VX16_INLINE bool FPU::isEmpty(ST reg) const
+    {
+        return isPhysicalEmpty(physical(reg));
+    }
+
+    VX16_INLINE double FPU::st(ST reg) const
+    {
+        detail::FPUContext context = { FPURounding::NEAREST, 64, 0 };
+        const size_t index = physical(reg);
+        return FPUMode::EXACT == m_mode ? detail::FastArithmetic::fromFloat80(m_exact[index], context) : m_fast[index];
+    }
+
+    VX16_INLINE Float80 FPU::stExtended(ST reg) const
+    {
+        detail::FPUContext context = { FPURounding::NEAREST, 64, 0 };
+        const size_t index = physical(reg);
+        return FPUMode::EXACT == m_mode ? m_exact[index] : detail::FastArithmetic::toFloat80(m_fast[index], context);
+    }
+
+    VX16_INLINE void FPU::load(ST reg)
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            push<detail::ExactArithmetic>(get<detail::ExactArithmetic>(reg));
+        }
+        else
+        {
+            push<detail::FastArithmetic>(get<detail::FastArithmetic>(reg));
+        }
+    }
+
+    VX16_INLINE void FPU::loadFloat32(dword_t value)
+    {
+        loadConverted(value, &detail::ExactArithmetic::fromFloat32, &detail::FastArithmetic::fromFloat32);
+    }
+
+    VX16_INLINE void FPU::loadFloat64(qword_t value)
+    {
+        loadConverted(value, &detail::ExactArithmetic::fromFloat64, &detail::FastArithmetic::fromFloat64);
+    }
+
+    VX16_INLINE void FPU::loadFloat80(Float80 value)
+    {
+        loadConverted<const Float80&>(value, &detail::ExactArithmetic::fromFloat80, &detail::FastArithmetic::fromFloat80);
+    }
+
+    VX16_INLINE void FPU::loadInt(int64_t value)
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            push<detail::ExactArithmetic>(detail::ExactArithmetic::fromInt(value));
+        }
+        else
+        {
+            push<detail::FastArithmetic>(detail::FastArithmetic::fromInt(value));
+        }
+    }
+
+    VX16_INLINE void FPU::loadConstant(FPUConstant value)
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            push<detail::ExactArithmetic>(detail::ExactArithmetic::constant(value, rounding()));
+        }
+        else
+        {
+            push<detail::FastArithmetic>(detail::FastArithmetic::constant(value, rounding()));
+        }
+    }
+
+    VX16_INLINE void FPU::store(ST reg, bool pop)
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            set<detail::ExactArithmetic>(reg, get<detail::ExactArithmetic>(ST::ST0));
+        }
+        else
+        {
+            set<detail::FastArithmetic>(reg, get<detail::FastArithmetic>(ST::ST0));
+        }
+
+        if (pop)
+        {
+            this->pop();
+        }
+    }
+
+    VX16_INLINE dword_t FPU::storeFloat32(bool pop)
+    {
+        return storeConverted<dword_t>(pop, &detail::ExactArithmetic::toFloat32, &detail::FastArithmetic::toFloat32);
+    }
+
+    VX16_INLINE qword_t FPU::storeFloat64(bool pop)
+    {
+        return storeConverted<qword_t>(pop, &detail::ExactArithmetic::toFloat64, &detail::FastArithmetic::toFloat64);
+    }
+
+    VX16_INLINE Float80 FPU::storeFloat80(bool pop)
+    {
+        return storeConverted<Float80>(pop, &detail::ExactArithmetic::toFloat80, &detail::FastArithmetic::toFloat80);
+    }
+
+    VX16_INLINE int64_t FPU::storeInt(unsigned bytes, bool pop)
+    {
+        return FPUMode::EXACT == m_mode ? storeIntImpl<detail::ExactArithmetic>(bytes, pop) : storeIntImpl<detail::FastArithmetic>(bytes, pop);
+    }
+
+    VX16_INLINE void FPU::arithmetic(FPUOperation operation, ST dst, ST src, bool pop)
+    {
+        assert((ST::ST0 == dst || ST::ST0 == src) && "one of operands must be ST0");
+
+        if (FPUMode::EXACT == m_mode)
+        {
+            arithmeticImpl<detail::ExactArithmetic>(operation, dst, get<detail::ExactArithmetic>(src));
+        }
+        else
+        {
+            arithmeticImpl<detail::FastArithmetic>(operation, dst, get<detail::FastArithmetic>(src));
+        }
+
+        if (pop)
+        {
+            this->pop();
+        }
+    }
+
+    VX16_INLINE void FPU::arithmeticFloat32(FPUOperation operation, dword_t value)
+    {
+        arithmeticConverted(operation, value, &detail::ExactArithmetic::fromFloat32, &detail::FastArithmetic::fromFloat32);
+    }
+
+    VX16_INLINE void FPU::arithmeticFloat64(FPUOperation operation, qword_t value)
+    {
+        arithmeticConverted(operation, value, &detail::ExactArithmetic::fromFloat64, &detail::FastArithmetic::fromFloat64);
+    }
+
+    VX16_INLINE void FPU::arithmeticInt(FPUOperation operation, int64_t value)
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            arithmeticImpl<detail::ExactArithmetic>(operation, ST::ST0, detail::ExactArithmetic::fromInt(value));
+        }
+        else
+        {
+            arithmeticImpl<detail::FastArithmetic>(operation, ST::ST0, detail::FastArithmetic::fromInt(value));
+        }
+    }
+
+    VX16_INLINE void FPU::compare(ST reg, unsigned pops)
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            compareImpl<detail::ExactArithmetic>(get<detail::ExactArithmetic>(reg), pops);
+        }
+        else
+        {
+            compareImpl<detail::FastArithmetic>(get<detail::FastArithmetic>(reg), pops);
+        }
+    }
+
+    VX16_INLINE void FPU::compareFloat32(dword_t value, unsigned pops)
+    {
+        compareConverted(value, pops, &detail::ExactArithmetic::fromFloat32, &detail::FastArithmetic::fromFloat32);
+    }
+
+    VX16_INLINE void FPU::compareFloat64(qword_t value, unsigned pops)
+    {
+        compareConverted(value, pops, &detail::ExactArithmetic::fromFloat64, &detail::FastArithmetic::fromFloat64);
+    }
+
+    VX16_INLINE void FPU::test()
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            compareImpl<detail::ExactArithmetic>(detail::ExactArithmetic::fromInt(0), 0);
+        }
+        else
+        {
+            compareImpl<detail::FastArithmetic>(detail::FastArithmetic::fromInt(0), 0);
+        }
+    }
+
+    VX16_INLINE void FPU::squareRoot()
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            unaryImpl<detail::ExactArithmetic>(&detail::ExactArithmetic::squareRoot);
+        }
+        else
+        {
+            unaryImpl<detail::FastArithmetic>(&detail::FastArithmetic::squareRoot);
+        }
+    }
+
+    VX16_INLINE void FPU::roundToIntegral()
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            unaryImpl<detail::ExactArithmetic>(&detail::ExactArithmetic::roundToIntegral);
+        }
+        else
+        {
+            unaryImpl<detail::FastArithmetic>(&detail::FastArithmetic::roundToIntegral);
+        }
+    }
+
+    VX16_INLINE void FPU::abs()
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            set<detail::ExactArithmetic>(ST::ST0, detail::ExactArithmetic::abs(get<detail::ExactArithmetic>(ST::ST0)));
+        }
+        else
+        {
+            set<detail::FastArithmetic>(ST::ST0, detail::FastArithmetic::abs(get<detail::FastArithmetic>(ST::ST0)));
+        }
+    }
+
+    VX16_INLINE void FPU::negate()
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            set<detail::ExactArithmetic>(ST::ST0, detail::ExactArithmetic::negate(get<detail::ExactArithmetic>(ST::ST0)));
+        }
+        else
+        {
+            set<detail::FastArithmetic>(ST::ST0, detail::FastArithmetic::negate(get<detail::FastArithmetic>(ST::ST0)));
+        }
+    }
+
+    VX16_INLINE void FPU::exchange(ST reg)
+    {
+        if (FPUMode::EXACT == m_mode)
+        {
+            exchangeImpl<detail::ExactArithmetic>(reg);
+        }
+        else
+        {
+            exchangeImpl<detail::FastArithmetic>(reg);
+        }
+    }
+
+    VX16_INLINE double* FPU::registers(detail::FastArithmetic)
+    {
+        return m_fast;
+    }
+
+    VX16_INLINE Float80* FPU::registers(detail::ExactArithmetic)
+    {
+        return m_exact;
+    }
+
+    VX16_INLINE size_t FPU::physical(ST reg) const
+    {
+        return (m_top + static_cast<size_t>(reg)) % REGISTER_COUNT;
+    }
+
+    VX16_INLINE bool FPU::isPhysicalEmpty(size_t index) const
+    {
+        return 0 != (m_empty & (1 << index));
+    }
+
+    VX16_INLINE FPURounding FPU::rounding() const
+    {
+        return static_cast<FPURounding>((m_control >> 10) & 3);
+    }
+
+    VX16_INLINE detail::FPUContext FPU::context() const
+    {
+        static const unsigned PRECISIONS[] = { 24, 64, 53, 64 };
+        return detail::FPUContext{ rounding(), PRECISIONS[(m_control >> 8) & 3], 0 };
+    }
+
+    VX16_INLINE void FPU::raise(word_t exceptions)
+    {
+        m_status |= exceptions;
+
+        // Unmasked exceptions are only reported via status word
+        if (0 != (m_status & ~m_control & EXCEPTION_MASK))
+        {
+            m_status |= STATUS_ERROR_SUMMARY | STATUS_BUSY;
+        }
+    }
+
+    VX16_INLINE void FPU::setConditionCodes(word_t codes)
+    {
+        m_status = word_t((m_status & ~CONDITION_MASK) | codes);
+    }
+
+    template <typename A>
+    VX16_INLINE typename A::Value FPU::get(ST reg)
+    {
+        const size_t index = physical(reg);
+
+        if (isPhysicalEmpty(index))
+        {
+            setConditionCodes(m_status & (STATUS_C0 | STATUS_C2 | STATUS_C3));
+            raise(STATUS_INVALID | STATUS_STACK_FAULT);
+            return A::indefinite();
+        }
+
+        return registers(A())[index];
+    }
+
+    template <typename A>
+    VX16_INLINE void FPU::set(ST reg, const typename A::Value& value)
+    {
+        const size_t index = physical(reg);
+        registers(A())[index] = value;
+        m_empty &= ~(1 << index);
+    }
+
+    template <typename A>
+    VX16_INLINE void FPU::push(typename A::Value value)
+    {
+        const size_t index = (m_top + REGISTER_COUNT - 1) % REGISTER_COUNT;
+
+        if (!isPhysicalEmpty(index))
+        {
+            setConditionCodes((m_status & (STATUS_C0 | STATUS_C2 | STATUS_C3)) | STATUS_C1);
+            raise(STATUS_INVALID | STATUS_STACK_FAULT);
+            value = A::indefinite();
+        }
+
+        m_top = static_cast<byte_t>(index);
+        set<A>(ST::ST0, value);
+    }
+
+    VX16_INLINE void FPU::pop()
+    {
+        m_empty |= 1 << m_top;
+        m_top = (m_top + 1) % REGISTER_COUNT;
+    }
+
+    template <typename T, typename F, typename E>
+    VX16_INLINE void FPU::loadConverted(T value, E (*exact)(T, detail::FPUContext&), F (*fast)(T, detail::FPUContext&))
+    {
+        detail::FPUContext context = this->context();
+
+        if (FPUMode::EXACT == m_mode)
+        {
+            push<detail::ExactArithmetic>(exact(value, context));
+        }
+        else
+        {
+            push<detail::FastArithmetic>(fast(value, context));
+        }
+
+        raise(context.m_exceptions);
+    }
+
+    template <typename T>
+    VX16_INLINE T FPU::storeConverted(bool pop, T (*exact)(const Float80&, detail::FPUContext&), T (*fast)(double, detail::FPUContext&))
+    {
+        detail::FPUContext context = this->context();
+        const T result = FPUMode::EXACT == m_mode
+            ? exact(get<detail::ExactArithmetic>(ST::ST0), context)
+            : fast(get<detail::FastArithmetic>(ST::ST0), context);
+
+        raise(context.m_exceptions);
+
+        if (pop)
+        {
+            this->pop();
+        }
+
+        return result;
+    }
+
+    template <typename A>
+    VX16_INLINE int64_t FPU::storeIntImpl(unsigned bytes, bool pop)
+    {
+        detail::FPUContext context = this->context();
+        int64_t result = 0;
+
+        if (!A::toInt(get<A>(ST::ST0), bytes, context, result))
+        {
+            context.m_exceptions |= STATUS_INVALID;
+            result = static_cast<int64_t>(qword_t(-1) << (bytes * 8 - 1));
+        }
+
+        raise(context.m_exceptions);
+
+        if (pop)
+        {
+            this->pop();
+        }
+
+        return result;
+    }
+
+    template <typename A>
+    VX16_INLINE void FPU::arithmeticImpl(FPUOperation operation, ST dst, const typename A::Value& src)
+    {
+        detail::FPUContext context = this->context();
+        const typename A::Value lhs = get<A>(dst);
+        typename A::Value result;
+
+        switch (operation)
+        {
+        case FPUOperation::ADD:  result = A::add(lhs, src, context); break;
+        case FPUOperation::SUB:  result = A::subtract(lhs, src, context); break;
+        case FPUOperation::SUBR: result = A::subtract(src, lhs, context); break;
+        case FPUOperation::MUL:  result = A::multiply(lhs, src, context); break;
+        case FPUOperation::DIV:  result = A::divide(lhs, src, context); break;
+        case FPUOperation::DIVR: result = A::divide(src, lhs, context); break;
+        default: result = A::indefinite(); assert(!"unknown operation"); break;
+        }
+
+        set<A>(dst, result);
+        raise(context.m_exceptions);
+    }
+
+    template <typename T, typename F, typename E>
+    VX16_INLINE void FPU::arithmeticConverted(FPUOperation operation, T value, E (*exact)(T, detail::FPUContext&), F (*fast)(T, detail::FPUContext&))
+    {
+        detail::FPUContext context = this->context();
+
+        if (FPUMode::EXACT == m_mode)
+        {
+            arithmeticImpl<detail::ExactArithmetic>(operation, ST::ST0, exact(value, context));
+        }
+        else
+        {
+            arithmeticImpl<detail::FastArithmetic>(operation, ST::ST0, fast(value, context));
+        }
+
+        raise(context.m_exceptions);
+    }
+
+    template <typename A>
+    VX16_INLINE void FPU::compareImpl(const typename A::Value& rhs, unsigned pops)
+    {
+        const typename A::Value lhs = get<A>(ST::ST0);
+
+        if (A::isNaN(lhs) || A::isNaN(rhs))
+        {
+            raise(STATUS_INVALID);
+            setConditionCodes(STATUS_C3 | STATUS_C2 | STATUS_C0);
+        }
+        else
+        {
+            const int order = A::compare(lhs, rhs);
+            setConditionCodes(order < 0 ? STATUS_C0 : 0 == order ? STATUS_C3 : 0);
+        }
+
+        for (unsigned i = 0; i < pops; ++i)
+        {
+            pop();
+        }
+    }
+
+    template <typename T, typename F, typename E>
+    VX16_INLINE void FPU::compareConverted(T value, unsigned pops, E (*exact)(T, detail::FPUContext&), F (*fast)(T, detail::FPUContext&))
+    {
+        detail::FPUContext context = this->context();
+
+        if (FPUMode::EXACT == m_mode)
+        {
+            compareImpl<detail::ExactArithmetic>(exact(value, context), pops);
+        }
+        else
+        {
+            compareImpl<detail::FastArithmetic>(fast(value, context), pops);
+        }
+
+        raise(context.m_exceptions);
+    }
+
+    template <typename A, typename F>
+    VX16_INLINE void FPU::unaryImpl(F function)
+    {
+        detail::FPUContext context = this->context();
+        set<A>(ST::ST0, function(get<A>(ST::ST0), context));
+        raise(context.m_exceptions);
+    }
+
+    template <typename A>
+    VX16_INLINE void FPU::exchangeImpl(ST reg)
+    {
+        const typename A::Value value = get<A>(ST::ST0);
+        set<A>(ST::ST0, get<A>(reg));
+        set<A>(reg, value);
+    }
+
+#endif // VX16_INCLUDE_IMPLEMENTATION
+
+    enum class CallKind : byte_t
+    {
+        NEAR,      // call, ret
+        FAR,       // callf, retf
+        INTERRUPT  // callInt, iret
+    };
+
+    // Host-side record of a guest call, used to validate stack balance on return
+    struct CallFrame
+    {
+        CallKind m_kind;
+        word_t m_ss;
+        word_t m_sp;            // stack pointer after return address was pushed
+        word_t m_returnSegment; // for far and interrupt calls only
+        word_t m_returnOffset;
+#ifdef VX16_PROFILER
+        Profiler::Node m_profilerNode; // call tree node of the caller
+#endif // VX16_PROFILER
+    };
+
+    typedef std::vector<CallFrame> CallStack;
+
+    class CPU
+    {
+    public:
+        explicit CPU(Memory* memory)
+        : m_memory(memory)
+        , m_eax(0), m_ebx(0), m_ecx(0), m_edx(0)
+        , m_ebp(0), m_esi(0), m_edi(0), m_esp(0)
+        , m_cs(0)
+        , m_ds(m_memory->allocPage())
+        , m_ss(m_memory->allocPage())
+        , m_es(0), m_fs(0), m_gs(0)
+        , m_flags(2)
+        {
+#ifdef VX16_WATCHPOINTS
+            m_memory->attachCPU(this);
+#endif // VX16_WATCHPOINTS
+        }
+
+        ~CPU()
+        {
+#ifdef VX16_WATCHPOINTS
+            m_memory->detachCPU(this);
+#endif // VX16_WATCHPOINTS
+        }
+
+        // Memory refers to the CPU, and so copy would be reported by watchpoints as the original
+        CPU(const CPU&) = delete;
+        CPU& operator=(const CPU&) = delete;
+
+        Memory* memory() const { return m_memory; }
+
+        byte_t value(R8 reg) const
+        {
+            return m_registers8[index(reg)];
+        }
+
+        word_t value(R16 reg) const
+        {
+            return m_registers16[index(reg)];
+        }
+
+        dword_t value(R32 reg) const
+        {
+            return m_registers32[index(reg)];
+        }
+
+        FarBytePtr bytePtr(word_t offset) const
+        {
+            return bytePtr(R16::DS, offset);
+        }
+
+        FarBytePtr bytePtr(NearBytePtr address) const
+        {
+            return bytePtr(address.m_offset);
+        }
+
+        FarBytePtr bytePtr(R16 segment, word_t offset) const
+        {
+            return FarBytePtr{ value(segment), offset };
+        }
+
+        FarBytePtr bytePtr(R16 segment, NearBytePtr address) const
+        {
+            return bytePtr(segment, address.m_offset);
+        }
+        
+        FarWordPtr wordPtr(word_t offset) const
+        {
+            return wordPtr(R16::DS, offset);
+        }
+
+        FarWordPtr wordPtr(NearWordPtr address) const
+        {
+            return wordPtr(address.m_offset);
+        }
+
+        FarWordPtr wordPtr(R16 segment, word_t offset) const
+        {
+            return FarWordPtr{ value(segment), offset };
+        }
+
+        FarWordPtr wordPtr(R16 segment, NearWordPtr address) const
+        {
+            return wordPtr(segment, address.m_offset);
+        }
+
+        FarDwordPtr dwordPtr(word_t offset) const
+        {
+            return dwordPtr(R16::DS, offset);
+        }
+
+        FarDwordPtr dwordPtr(NearDwordPtr address) const
+        {
+            return dwordPtr(address.m_offset);
+        }
+
+        FarDwordPtr dwordPtr(R16 segment, word_t offset) const
+        {
+            return FarDwordPtr{ value(segment), offset };
+        }
+
+        FarDwordPtr dwordPtr(R16 segment, NearDwordPtr address) const
+        {
+            return dwordPtr(segment, address.m_offset);
+        }
+
+        FarQwordPtr qwordPtr(word_t offset) const
+        {
+            return qwordPtr(R16::DS, offset);
+        }
+
+        FarQwordPtr qwordPtr(NearQwordPtr address) const
+        {
+            return qwordPtr(address.m_offset);
+        }
+
+        FarQwordPtr qwordPtr(R16 segment, word_t offset) const
+        {
+            return FarQwordPtr{ value(segment), offset };
+        }
+
+        FarQwordPtr qwordPtr(R16 segment, NearQwordPtr address) const
+        {
+            return qwordPtr(segment, address.m_offset);
+        }
+
+        FarTbytePtr tbytePtr(word_t offset) const
+        {
+            return tbytePtr(R16::DS, offset);
+        }
+
+        FarTbytePtr tbytePtr(NearTbytePtr address) const
+        {
+            return tbytePtr(address.m_offset);
+        }
+
+        FarTbytePtr tbytePtr(R16 segment, word_t offset) const
+        {
+            return FarTbytePtr{ value(segment), offset };
+        }
+
+        FarTbytePtr tbytePtr(R16 segment, NearTbytePtr address) const
+        {
+            return tbytePtr(segment, address.m_offset);
+        }
+
+        byte_t al() const { return m_al; }
+        byte_t ah() const { return m_ah; }
+        byte_t bl() const { return m_bl; }
+        byte_t bh() const { return m_bh; }
+        byte_t cl() const { return m_cl; }
+        byte_t ch() const { return m_ch; }
+        byte_t dl() const { return m_dl; }
+        byte_t dh() const { return m_dh; }
+
+        word_t ax() const { return m_ax; }
+        word_t bx() const { return m_bx; }
+        word_t cx() const { return m_cx; }
+        word_t dx() const { return m_dx; }
+
+        word_t bp() const { return m_bp; }
+        word_t si() const { return m_si; }
+        word_t di() const { return m_di; }
+        word_t sp() const { return m_sp; }
+
+        dword_t eax() const { return m_eax; }
+        dword_t ebx() const { return m_ebx; }
+        dword_t ecx() const { return m_ecx; }
+        dword_t edx() const { return m_edx; }
+
+        dword_t ebp() const { return m_ebp; }
+        dword_t esi() const { return m_esi; }
+        dword_t edi() const { return m_edi; }
+        dword_t esp() const { return m_esp; }
+
+        word_t cs() const { return m_cs; }
+        word_t ds() const { return m_ds; }
+        word_t ss() const { return m_ss; }
+        word_t es() const { return m_es; }
+        word_t fs() const { return m_fs; }
+        word_t gs() const { return m_gs; }
+
+        bool cf() const { return m_cf; }
+        bool pf() const { return m_pf; }
+        bool af() const { return m_af; }
+        bool zf() const { return m_zf; }
+        bool sf() const { return m_sf; }
+        bool df() const { return m_df; }
+        bool of() const { return m_of; }
+
+        word_t flags() const { return m_flags; }
+
+        void mov(R8 reg, byte_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, imm);
+        }
+
+        void mov(R8 regDst, R8 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, value(regSrc));
+        }
+
+        void mov(R16 reg, word_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, imm);
+        }
+
+        void mov(R16 regDst, R16 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, value(regSrc));
+        }
+
+        void mov(NearBytePtr address, byte_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(byte_t));
+            m_memory->set(bytePtr(address), imm);
+        }
+
+        void mov(NearWordPtr address, word_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(wordPtr(address), imm);
+        }
+
+        void mov(NearBytePtr address, R8 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(byte_t));
+            m_memory->set(bytePtr(address), value(reg));
+        }
+
+        void mov(NearWordPtr address, R16 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(wordPtr(address), value(reg));
+        }
+
+        void mov(R8 reg, NearBytePtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(byte_t));
+            const byte_t value = m_memory->get(bytePtr(address));
+            setValue(reg, value);
+        }
+
+        void mov(R16 reg, NearWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            const word_t value = m_memory->get(wordPtr(address));
+            setValue(reg, value);
+        }
+
+        void mov(FarBytePtr address, byte_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(byte_t));
+            m_memory->set(address, imm);
+        }
+
+        void mov(FarWordPtr address, word_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(address, imm);
+        }
+
+        void mov(FarBytePtr address, R8 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(byte_t));
+            m_memory->set(address, value(reg));
+        }
+
+        void mov(FarWordPtr address, R16 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(address, value(reg));
+        }
+
+        void mov(R8 reg, FarBytePtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(byte_t));
+            setValue(reg, m_memory->get(address));
+        }
+
+        void mov(R16 reg, FarWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            setValue(reg, m_memory->get(address));
+        }
+
+        // 32-bit operations, i.e. ones with operand-size prefix
+
+        void mov(R32 reg, dword_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, imm);
+        }
+
+        void mov(R32 regDst, R32 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, value(regSrc));
+        }
+
+        void mov(NearDwordPtr address, dword_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            m_memory->set(dwordPtr(address), imm);
+        }
+
+        void mov(NearDwordPtr address, R32 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            m_memory->set(dwordPtr(address), value(reg));
+        }
+
+        void mov(R32 reg, NearDwordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            setValue(reg, m_memory->get(dwordPtr(address)));
+        }
+
+        void mov(FarDwordPtr address, dword_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            m_memory->set(address, imm);
+        }
+
+        void mov(FarDwordPtr address, R32 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            m_memory->set(address, value(reg));
+        }
+
+        void mov(R32 reg, FarDwordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            setValue(reg, m_memory->get(address));
+        }
+
+        void cwd(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(0);
+            m_dx = (m_ax & 0x8000) ? 0xFFFF : 0;
+        }
+
+        void xlat(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(sizeof(byte_t));
+            m_al = m_memory->get(bytePtr(m_bx + m_al));
+        }
+
+        void push(word_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            pushWord(imm);
+        }
+
+        void push(R16 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            pushWord(value(reg));
+        }
+
+        void push(NearWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t) * 2);
+            const word_t value = m_memory->get<word_t>(m_ds, address.m_offset);
+            pushWord(value);
+        }
+
+        void push(FarWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t) * 2);
+            const word_t value = m_memory->get(address);
+            pushWord(value);
+        }
+
+        word_t pop(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            return popWord();
+        }
+
+        void pop(R16 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            setValue(reg, popWord());
+        }
+
+        void pop(NearWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t) * 2);
+            m_memory->set(m_ds, address.m_offset, popWord());
+        }
+
+        void pop(FarWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t) * 2);
+            m_memory->set(address, popWord());
+        }
+
+        // Named differently from push(word_t) to avoid ambiguity with integer literals
+        void pushd(dword_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            pushDword(imm);
+        }
+
+        void push(R32 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            pushDword(value(reg));
+        }
+
+        void push(FarDwordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t) * 2);
+            pushDword(m_memory->get(address));
+        }
+
+        dword_t popd(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            return popDword();
+        }
+
+        void pop(R32 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            setValue(reg, popDword());
+        }
+
+        void pop(FarDwordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t) * 2);
+            m_memory->set(address, popDword());
+        }
+
+        void pusha(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(sizeof(word_t) * 8);
+            const word_t sp = m_sp;
+            pushWord(m_ax);
+            pushWord(m_cx);
+            pushWord(m_dx);
+            pushWord(m_bx);
+            pushWord(sp);
+            pushWord(m_bp);
+            pushWord(m_si);
+            pushWord(m_di);
+        }
+
+        void popa(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(sizeof(word_t) * 7);
+            m_di = popWord();
+            m_si = popWord();
+            m_bp = popWord();
+            m_sp += 2;
+            m_bx = popWord();
+            m_dx = popWord();
+            m_cx = popWord();
+            m_ax = popWord();
+        }
+
+        void enter(word_t size, word_t nesting VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            assert(0 == nesting && "nesting is not supported yet");
+            (void)nesting;
+            pushWord(m_bp);
+            m_bp = m_sp;
+            m_sp -= size;
+        }
+
+        void leave(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            m_sp = m_bp;
+            m_bp = popWord();
+        }
+
+        void add(R8 reg, byte_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, addValues(value(reg), imm));
+        }
+
+        void add(R8 regDst, R8 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, addValues(value(regDst), value(regSrc)));
+        }
+
+        void add(R16 reg, word_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, addValues(value(reg), imm));
+        }
+
+        void add(R16 regDst, R16 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, addValues(value(regDst), value(regSrc)));
+        }
+
+        void add(R32 reg, dword_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, addValues(value(reg), imm));
+        }
+
+        void add(R32 regDst, R32 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, addValues(value(regDst), value(regSrc)));
+        }
+
+        void add(R16 reg, FarWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            setValue(reg, addValues(value(reg), m_memory->get(address)));
+        }
+
+        void add(FarWordPtr address, R16 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t) * 2);
+            m_memory->set(address, addValues(m_memory->get(address), value(reg)));
+        }
+
+        void add(R32 reg, FarDwordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t));
+            setValue(reg, addValues(value(reg), m_memory->get(address)));
+        }
+
+        void add(FarDwordPtr address, R32 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(dword_t) * 2);
+            m_memory->set(address, addValues(m_memory->get(address), value(reg)));
+        }
+
+        // Signed multiplication, only CF and OF are defined, other arithmetic flags are left intact
+
+        void imul(R8 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            m_ax = static_cast<word_t>(multiplySigned<int16_t>(m_al, value(reg)));
+        }
+
+        void imul(R16 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            const dword_t result = static_cast<dword_t>(multiplySigned<int32_t>(m_ax, value(reg)));
+            m_ax = static_cast<word_t>(result);
+            m_dx = static_cast<word_t>(result >> 16);
+        }
+
+        void imul(R32 reg VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            const qword_t result = static_cast<qword_t>(multiplySigned<int64_t>(m_eax, value(reg)));
+            m_eax = static_cast<dword_t>(result);
+            m_edx = static_cast<dword_t>(result >> 32);
+        }
+
+        void imul(R16 regDst, R16 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, static_cast<word_t>(multiplySigned<int32_t>(value(regDst), value(regSrc))));
+        }
+
+        void imul(R32 regDst, R32 regSrc VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, static_cast<dword_t>(multiplySigned<int64_t>(value(regDst), value(regSrc))));
+        }
+
+        void imul(R16 regDst, R16 regSrc, word_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, static_cast<word_t>(multiplySigned<int32_t>(value(regSrc), imm)));
+        }
+
+        void imul(R32 regDst, R32 regSrc, dword_t imm VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(regDst, static_cast<dword_t>(multiplySigned<int64_t>(value(regSrc), imm)));
+        }
+
+        // Count is masked to five bits like on 386, AF is left intact
+
+        void shl(R8 reg, byte_t count VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, shiftLeft(value(reg), count));
+        }
+
+        void shl(R16 reg, byte_t count VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, shiftLeft(value(reg), count));
+        }
 
-        BP = 4,
-        SI = 5,
-        DI = 6,
-        SP = 7,
+        void shl(R32 reg, byte_t count VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            setValue(reg, shiftLeft(value(reg), count));
+        }
 
-        CS = 8,
-        DS = 9,
-        SS = 10,
-        ES = 11,
-        FS = 12,
-        GS = 13,
+        void shl(R8 reg, R8 count VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            assert(R8::CL == count && "only CL is allowed");
+            setValue(reg, shiftLeft(value(reg), value(count)));
+        }
 
-        FLAGS = 14,
+        void shl(R16 reg, R8 count VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            assert(R8::CL == count && "only CL is allowed");
+            setValue(reg, shiftLeft(value(reg), value(count)));
+        }
 
-        COUNT
-    };
+        void shl(R32 reg, R8 count VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            assert(R8::CL == count && "only CL is allowed");
+            setValue(reg, shiftLeft(value(reg), value(count)));
+        }
 
-    class CPU
-    {
-    public:
-        explicit CPU(Memory* memory)
-        : m_memory(memory)
-        , m_ax(0), m_bx(0), m_cx(0), m_dx(0)
-        , m_bp(0), m_si(0), m_di(0), m_sp(0)
-        , m_cs(0)
-        , m_ds(m_memory->allocPage())
-        , m_ss(m_memory->allocPage())
-        , m_es(0), m_fs(0), m_gs(0)
-        , m_flags(2)
+        // String moves from DS:SI to ES:DI with 16-bit addressing, i.e. SI, DI and CX are used
+
+        void movsb(VX16_SOURCE_LOCATION_ONLY)
         {
+            VX16_PROFILE(sizeof(byte_t) * 2);
+            moveString<byte_t>();
         }
 
-        Memory* memory() const { return m_memory; }
+        void movsw(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(sizeof(word_t) * 2);
+            moveString<word_t>();
+        }
 
-        byte_t value(R8 reg) const
+        void movsd(VX16_SOURCE_LOCATION_ONLY)
         {
-            const size_t index = static_cast<size_t>(reg);
-            return m_registers8[index];
+            VX16_PROFILE(sizeof(dword_t) * 2);
+            moveString<dword_t>();
         }
 
-        word_t value(R16 reg) const
+        void repMovsb(VX16_SOURCE_LOCATION_ONLY)
         {
-            const size_t index = static_cast<size_t>(reg);
-            return m_registers16[index];
+            VX16_PROFILE(sizeof(byte_t) * 2 * m_cx);
+            repMoveString<byte_t>();
         }
 
-        FarBytePtr bytePtr(word_t offset) const
+        void repMovsw(VX16_SOURCE_LOCATION_ONLY)
         {
-            return bytePtr(R16::DS, offset);
+            VX16_PROFILE(sizeof(word_t) * 2 * m_cx);
+            repMoveString<word_t>();
         }
 
-        FarBytePtr bytePtr(NearBytePtr address) const
+        void repMovsd(VX16_SOURCE_LOCATION_ONLY)
         {
-            return bytePtr(address.m_offset);
+            VX16_PROFILE(sizeof(dword_t) * 2 * m_cx);
+            repMoveString<dword_t>();
         }
 
-        FarBytePtr bytePtr(R16 segment, word_t offset) const
+        // Calls push guest-visible return addresses only, the called routine
+        // is invoked by the caller as a usual C++ function right after that
+
+        void call(word_t returnOffset VX16_SOURCE_LOCATION)
         {
-            return FarBytePtr{ value(segment), offset };
+            VX16_PROFILE(sizeof(word_t));
+            pushWord(returnOffset);
+            enterFrame(CallKind::NEAR, 0, returnOffset VX16_SOURCE_LOCATION_ARGUMENT);
         }
 
-        FarBytePtr bytePtr(R16 segment, NearBytePtr address) const
+        void callf(word_t segment, word_t returnOffset VX16_SOURCE_LOCATION)
         {
-            return bytePtr(segment, address.m_offset);
+            VX16_PROFILE(sizeof(word_t) * 2);
+            const word_t returnSegment = m_cs;
+            pushWord(returnSegment);
+            pushWord(returnOffset);
+            m_cs = segment;
+            enterFrame(CallKind::FAR, returnSegment, returnOffset VX16_SOURCE_LOCATION_ARGUMENT);
         }
-        
-        FarWordPtr wordPtr(word_t offset) const
+
+        // Far call of interrupt handler, i.e. int instruction with explicit handler address
+        void callInt(word_t segment, word_t returnOffset VX16_SOURCE_LOCATION)
         {
-            return wordPtr(R16::DS, offset);
+            VX16_PROFILE(sizeof(word_t) * 3);
+            const word_t returnSegment = m_cs;
+            pushWord(m_flags);
+            pushWord(returnSegment);
+            pushWord(returnOffset);
+            m_cs = segment;
+            m_tf = 0;
+            m_if = 0;
+            enterFrame(CallKind::INTERRUPT, returnSegment, returnOffset VX16_SOURCE_LOCATION_ARGUMENT);
         }
 
-        FarWordPtr wordPtr(NearWordPtr address) const
+        // Returns pop return address and release the given number of argument bytes,
+        // popped return offset is returned so a caller can dispatch on it if needed
+
+        word_t ret(word_t size = 0 VX16_SOURCE_LOCATION)
         {
-            return wordPtr(address.m_offset);
+            VX16_PROFILE(sizeof(word_t));
+            leaveFrame(CallKind::NEAR);
+            const word_t offset = popWord();
+            m_sp += size;
+            return offset;
         }
 
-        FarWordPtr wordPtr(R16 segment, word_t offset) const
+        word_t retf(word_t size = 0 VX16_SOURCE_LOCATION)
         {
-            return FarWordPtr{ value(segment), offset };
+            VX16_PROFILE(sizeof(word_t) * 2);
+            leaveFrame(CallKind::FAR);
+            const word_t offset = popWord();
+            m_cs = popWord();
+            m_sp += size;
+            return offset;
         }
 
-        FarWordPtr wordPtr(R16 segment, NearWordPtr address) const
+        word_t iret(VX16_SOURCE_LOCATION_ONLY)
         {
-            return wordPtr(segment, address.m_offset);
+            VX16_PROFILE(sizeof(word_t) * 3);
+            leaveFrame(CallKind::INTERRUPT);
+            const word_t offset = popWord();
+            m_cs = popWord();
+            m_flags = popWord();
+            return offset;
         }
 
-        byte_t al() const { return m_al; }
-        byte_t ah() const { return m_ah; }
-        byte_t bl() const { return m_bl; }
-        byte_t bh() const { return m_bh; }
-        byte_t cl() const { return m_cl; }
-        byte_t ch() const { return m_ch; }
-        byte_t dl() const { return m_dl; }
-        byte_t dh() const { return m_dh; }
+        // Far jump switches code segment without creating a frame, ported code continues at the target
+        // by itself, e.g. with goto or tail call, target offset is returned so it can dispatch on it
+        word_t jmpf(word_t segment, word_t offset VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(0);
+            m_cs = segment;
+            return offset;
+        }
 
-        word_t ax() const { return m_ax; }
-        word_t bx() const { return m_bx; }
-        word_t cx() const { return m_cx; }
-        word_t dx() const { return m_dx; }
+        const CallStack& callStack() const { return m_callStack; }
+        size_t callDepth() const { return m_callStack.size(); }
 
-        word_t bp() const { return m_bp; }
-        word_t si() const { return m_si; }
-        word_t di() const { return m_di; }
-        word_t sp() const { return m_sp; }
+        // Returns that didn't match the innermost call, e.g. 'push target; ret' used as computed jump
+        size_t unmatchedReturnCount() const { return m_unmatchedReturns; }
 
-        word_t cs() const { return m_cs; }
-        word_t ds() const { return m_ds; }
-        word_t ss() const { return m_ss; }
-        word_t es() const { return m_es; }
-        word_t fs() const { return m_fs; }
-        word_t gs() const { return m_gs; }
+        // x87 instructions, memory operands use far pointers only
 
-        bool cf() const { return m_cf; }
-        bool pf() const { return m_pf; }
-        bool af() const { return m_af; }
-        bool zf() const { return m_zf; }
-        bool sf() const { return m_sf; }
-        bool df() const { return m_df; }
-        bool of() const { return m_of; }
+        FPU& fpu() { return m_fpu; }
+        const FPU& fpu() const { return m_fpu; }
 
-        word_t flags() const { return m_flags; }
+        void finit(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(0);
+            m_fpu.init();
+        }
 
-        void mov(R8 reg, byte_t imm)
+        void fld(ST reg VX16_SOURCE_LOCATION)
         {
-            setValue(reg, imm);
+            VX16_PROFILE(0);
+            m_fpu.load(reg);
         }
 
-        void mov(R8 regDst, R8 regSrc)
+        void fld(FarDwordPtr address VX16_SOURCE_LOCATION)
         {
-            setValue(regDst, value(regSrc));
+            VX16_PROFILE(sizeof(dword_t));
+            m_fpu.loadFloat32(m_memory->get(address));
         }
 
-        void mov(R16 reg, word_t imm)
+        void fld(FarQwordPtr address VX16_SOURCE_LOCATION)
         {
-            setValue(reg, imm);
+            VX16_PROFILE(sizeof(qword_t));
+            m_fpu.loadFloat64(m_memory->get(address));
         }
 
-        void mov(R16 regDst, R16 regSrc)
+        void fld(FarTbytePtr address VX16_SOURCE_LOCATION)
         {
-            setValue(regDst, value(regSrc));
+            VX16_PROFILE(10);
+            m_fpu.loadFloat80(m_memory->get(address));
         }
 
-        void mov(NearBytePtr address, byte_t imm)
+        void fild(FarWordPtr address VX16_SOURCE_LOCATION)
         {
-            m_memory->set(bytePtr(address), imm);
+            VX16_PROFILE(sizeof(word_t));
+            m_fpu.loadInt(static_cast<int16_t>(m_memory->get(address)));
         }
 
-        void mov(NearWordPtr address, word_t imm)
+        void fild(FarDwordPtr address VX16_SOURCE_LOCATION)
         {
-            m_memory->set(wordPtr(address), imm);
+            VX16_PROFILE(sizeof(dword_t));
+            m_fpu.loadInt(static_cast<int32_t>(m_memory->get(address)));
         }
 
-        void mov(NearBytePtr address, R8 reg)
+        void fild(FarQwordPtr address VX16_SOURCE_LOCATION)
         {
-            m_memory->set(bytePtr(address), value(reg));
+            VX16_PROFILE(sizeof(qword_t));
+            m_fpu.loadInt(static_cast<int64_t>(m_memory->get(address)));
         }
 
-        void mov(NearWordPtr address, R16 reg)
+        void fldz(VX16_SOURCE_LOCATION_ONLY)
         {
-            m_memory->set(wordPtr(address), value(reg));
+            VX16_PROFILE(0);
+            m_fpu.loadConstant(FPUConstant::ZERO);
         }
 
-        void mov(R8 reg, NearBytePtr address)
+        void fld1(VX16_SOURCE_LOCATION_ONLY)
         {
-            const byte_t value = m_memory->get(bytePtr(address));
-            setValue(reg, value);
+            VX16_PROFILE(0);
+            m_fpu.loadConstant(FPUConstant::ONE);
         }
 
-        void mov(R16 reg, NearWordPtr address)
+        void fldpi(VX16_SOURCE_LOCATION_ONLY)
         {
-            const word_t value = m_memory->get(wordPtr(address));
-            setValue(reg, value);
+            VX16_PROFILE(0);
+            m_fpu.loadConstant(FPUConstant::PI);
         }
 
-        void mov(FarBytePtr address, byte_t imm)
+        void fldl2t(VX16_SOURCE_LOCATION_ONLY)
         {
-            m_memory->set(address, imm);
+            VX16_PROFILE(0);
+            m_fpu.loadConstant(FPUConstant::L2T);
         }
 
-        void mov(FarWordPtr address, word_t imm)
+        void fldl2e(VX16_SOURCE_LOCATION_ONLY)
         {
-            m_memory->set(address, imm);
+            VX16_PROFILE(0);
+            m_fpu.loadConstant(FPUConstant::L2E);
         }
 
-        void mov(FarBytePtr address, R8 reg)
+        void fldlg2(VX16_SOURCE_LOCATION_ONLY)
         {
-            m_memory->set(address, value(reg));
+            VX16_PROFILE(0);
+            m_fpu.loadConstant(FPUConstant::LG2);
         }
 
-        void mov(FarWordPtr address, R16 reg)
+        void fldln2(VX16_SOURCE_LOCATION_ONLY)
         {
-            m_memory->set(address, value(reg));
+            VX16_PROFILE(0);
+            m_fpu.loadConstant(FPUConstant::LN2);
+        }
+
+#define VX16_DEFINE_FPU_STORE(NAME, POP)                                     \
+        void NAME(ST reg VX16_SOURCE_LOCATION)                               \
+        {                                                                    \
+            VX16_PROFILE(0);                                                 \
+            m_fpu.store(reg, POP);                                           \
+        }                                                                    \
+                                                                             \
+        void NAME(FarDwordPtr address VX16_SOURCE_LOCATION)                  \
+        {                                                                    \
+            VX16_PROFILE(sizeof(dword_t));                                   \
+            m_memory->set(address, m_fpu.storeFloat32(POP));                 \
+        }                                                                    \
+                                                                             \
+        void NAME(FarQwordPtr address VX16_SOURCE_LOCATION)                  \
+        {                                                                    \
+            VX16_PROFILE(sizeof(qword_t));                                   \
+            m_memory->set(address, m_fpu.storeFloat64(POP));                 \
         }
 
-        void mov(R8 reg, FarBytePtr address)
+        VX16_DEFINE_FPU_STORE(fst, false)
+        VX16_DEFINE_FPU_STORE(fstp, true)
+
+#undef VX16_DEFINE_FPU_STORE
+
+        void fstp(FarTbytePtr address VX16_SOURCE_LOCATION)
         {
-            setValue(reg, m_memory->get(address));
+            VX16_PROFILE(10);
+            m_memory->set(address, m_fpu.storeFloat80(true));
         }
 
-        void mov(R16 reg, FarWordPtr address)
+        void fist(FarWordPtr address VX16_SOURCE_LOCATION)
         {
-            setValue(reg, m_memory->get(address));
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(address, static_cast<word_t>(m_fpu.storeInt(sizeof(word_t), false)));
         }
 
-        void cwd()
+        void fist(FarDwordPtr address VX16_SOURCE_LOCATION)
         {
-            m_dx = (m_ax & 0x8000) ? 0xFFFF : 0;
+            VX16_PROFILE(sizeof(dword_t));
+            m_memory->set(address, static_cast<dword_t>(m_fpu.storeInt(sizeof(dword_t), false)));
         }
 
-        void xlat()
+        void fistp(FarWordPtr address VX16_SOURCE_LOCATION)
         {
-            m_al = m_memory->get(bytePtr(m_bx + m_al));
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(address, static_cast<word_t>(m_fpu.storeInt(sizeof(word_t), true)));
         }
 
-        void push(word_t imm)
+        void fistp(FarDwordPtr address VX16_SOURCE_LOCATION)
         {
-            m_sp -= 2;
-            m_memory->set(m_ss, m_sp, imm);
+            VX16_PROFILE(sizeof(dword_t));
+            m_memory->set(address, static_cast<dword_t>(m_fpu.storeInt(sizeof(dword_t), true)));
         }
 
-        void push(R16 reg)
+        void fistp(FarQwordPtr address VX16_SOURCE_LOCATION)
         {
-            push(value(reg));
+            VX16_PROFILE(sizeof(qword_t));
+            m_memory->set(address, static_cast<qword_t>(m_fpu.storeInt(sizeof(qword_t), true)));
         }
 
-        void push(NearWordPtr address)
+        // fadd, faddp, fiadd and so on, register forms compute dst = dst op src
+#define VX16_DEFINE_FPU_ARITHMETIC(NAME, OPERATION)                                         \
+        void f##NAME(FarDwordPtr address VX16_SOURCE_LOCATION)                              \
+        {                                                                                   \
+            VX16_PROFILE(sizeof(dword_t));                                                  \
+            m_fpu.arithmeticFloat32(FPUOperation::OPERATION, m_memory->get(address));       \
+        }                                                                                   \
+                                                                                            \
+        void f##NAME(FarQwordPtr address VX16_SOURCE_LOCATION)                              \
+        {                                                                                   \
+            VX16_PROFILE(sizeof(qword_t));                                                  \
+            m_fpu.arithmeticFloat64(FPUOperation::OPERATION, m_memory->get(address));       \
+        }                                                                                   \
+                                                                                            \
+        void f##NAME(ST dst, ST src VX16_SOURCE_LOCATION)                                   \
+        {                                                                                   \
+            VX16_PROFILE(0);                                                                \
+            m_fpu.arithmetic(FPUOperation::OPERATION, dst, src, false);                     \
+        }                                                                                   \
+                                                                                            \
+        void f##NAME##p(ST dst = ST::ST1 VX16_SOURCE_LOCATION)                              \
+        {                                                                                   \
+            VX16_PROFILE(0);                                                                \
+            m_fpu.arithmetic(FPUOperation::OPERATION, dst, ST::ST0, true);                  \
+        }                                                                                   \
+                                                                                            \
+        void fi##NAME(FarWordPtr address VX16_SOURCE_LOCATION)                              \
+        {                                                                                   \
+            VX16_PROFILE(sizeof(word_t));                                                   \
+            m_fpu.arithmeticInt(FPUOperation::OPERATION,                                    \
+                static_cast<int16_t>(m_memory->get(address)));                              \
+        }                                                                                   \
+                                                                                            \
+        void fi##NAME(FarDwordPtr address VX16_SOURCE_LOCATION)                             \
+        {                                                                                   \
+            VX16_PROFILE(sizeof(dword_t));                                                  \
+            m_fpu.arithmeticInt(FPUOperation::OPERATION,                                    \
+                static_cast<int32_t>(m_memory->get(address)));                              \
+        }
+
+        VX16_DEFINE_FPU_ARITHMETIC(add,  ADD)
+        VX16_DEFINE_FPU_ARITHMETIC(sub,  SUB)
+        VX16_DEFINE_FPU_ARITHMETIC(subr, SUBR)
+        VX16_DEFINE_FPU_ARITHMETIC(mul,  MUL)
+        VX16_DEFINE_FPU_ARITHMETIC(div,  DIV)
+        VX16_DEFINE_FPU_ARITHMETIC(divr, DIVR)
+
+#undef VX16_DEFINE_FPU_ARITHMETIC
+
+        void fsqrt(VX16_SOURCE_LOCATION_ONLY)
         {
-            const word_t value = m_memory->get<word_t>(m_ds, address.m_offset);
-            push(value);
+            VX16_PROFILE(0);
+            m_fpu.squareRoot();
         }
 
-        void push(FarWordPtr address)
+        void fabs(VX16_SOURCE_LOCATION_ONLY)
         {
-            const word_t value = m_memory->get(address);
-            push(value);
+            VX16_PROFILE(0);
+            m_fpu.abs();
         }
 
-        word_t pop()
+        void fchs(VX16_SOURCE_LOCATION_ONLY)
         {
-            const word_t value = m_memory->get<word_t>(m_ss, m_sp);
-            m_sp += 2;
-            return value;
+            VX16_PROFILE(0);
+            m_fpu.negate();
         }
 
-        void pop(R16 reg)
+        void frndint(VX16_SOURCE_LOCATION_ONLY)
         {
-            setValue(reg, pop());
+            VX16_PROFILE(0);
+            m_fpu.roundToIntegral();
         }
 
-        void pop(NearWordPtr address)
+        void fxch(ST reg = ST::ST1 VX16_SOURCE_LOCATION)
         {
-            m_memory->set(m_ds, address.m_offset, pop());
+            VX16_PROFILE(0);
+            m_fpu.exchange(reg);
+        }
+
+#define VX16_DEFINE_FPU_COMPARE(NAME, POPS)                                  \
+        void NAME(ST reg = ST::ST1 VX16_SOURCE_LOCATION)                     \
+        {                                                                    \
+            VX16_PROFILE(0);                                                 \
+            m_fpu.compare(reg, POPS);                                        \
+        }                                                                    \
+                                                                             \
+        void NAME(FarDwordPtr address VX16_SOURCE_LOCATION)                  \
+        {                                                                    \
+            VX16_PROFILE(sizeof(dword_t));                                   \
+            m_fpu.compareFloat32(m_memory->get(address), POPS);              \
+        }                                                                    \
+                                                                             \
+        void NAME(FarQwordPtr address VX16_SOURCE_LOCATION)                  \
+        {                                                                    \
+            VX16_PROFILE(sizeof(qword_t));                                   \
+            m_fpu.compareFloat64(m_memory->get(address), POPS);              \
         }
 
-        void pop(FarWordPtr address)
+        VX16_DEFINE_FPU_COMPARE(fcom, 0)
+        VX16_DEFINE_FPU_COMPARE(fcomp, 1)
+
+#undef VX16_DEFINE_FPU_COMPARE
+
+        void fcompp(VX16_SOURCE_LOCATION_ONLY)
         {
-            m_memory->set(address, pop());
+            VX16_PROFILE(0);
+            m_fpu.compare(ST::ST1, 2);
         }
 
-        void pusha()
+        void ftst(VX16_SOURCE_LOCATION_ONLY)
         {
-            const word_t sp = m_sp;
-            push(m_ax);
-            push(m_cx);
-            push(m_dx);
-            push(m_bx);
-            push(sp);
-            push(m_bp);
-            push(m_si);
-            push(m_di);
+            VX16_PROFILE(0);
+            m_fpu.test();
         }
 
-        void popa()
+        void fstsw(R16 reg VX16_SOURCE_LOCATION)
         {
-            m_di = pop();
-            m_si = pop();
-            m_bp = pop();
-            m_sp += 2;
-            m_bx = pop();
-            m_dx = pop();
-            m_cx = pop();
-            m_ax = pop();
+            VX16_PROFILE(0);
+            assert(R16::AX == reg && "only AX is allowed");
+            setValue(reg, m_fpu.statusWord());
         }
 
-        void enter(word_t size, word_t nesting)
+        void fstsw(FarWordPtr address VX16_SOURCE_LOCATION)
         {
-            assert(0 == nesting && "nesting is not supported yet");
-            push(m_bp);
-            m_bp = m_sp;
-            m_sp -= size;
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(address, m_fpu.statusWord());
         }
 
-        void leave()
+        void fstcw(FarWordPtr address VX16_SOURCE_LOCATION)
         {
-            m_sp = m_bp;
-            m_bp = pop();
+            VX16_PROFILE(sizeof(word_t));
+            m_memory->set(address, m_fpu.controlWord());
+        }
+
+        void fldcw(FarWordPtr address VX16_SOURCE_LOCATION)
+        {
+            VX16_PROFILE(sizeof(word_t));
+            m_fpu.setControlWord(m_memory->get(address));
+        }
+
+        void fclex(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(0);
+            m_fpu.clearExceptions();
+        }
+
+        // Status flags transfer, usually after fstsw ax to branch on FPU comparison
+        void sahf(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(0);
+            m_flags = word_t((m_flags & 0xFF00) | (m_ah & 0xD5) | 0x02);
+        }
+
+        void lahf(VX16_SOURCE_LOCATION_ONLY)
+        {
+            VX16_PROFILE(0);
+            m_ah = static_cast<byte_t>(m_flags);
         }
 
     private:
         Memory* m_memory;
+        CallStack m_callStack;
+        size_t m_unmatchedReturns = 0;
+        FPU m_fpu;
+
+#ifdef VX16_PROFILER
+        Profiler::Node m_profilerNode = 0;
+#endif // VX16_PROFILER
 
-        static const size_t REGISTER_COUNT = size_t(R16::COUNT);
+        static const size_t GENERAL_REGISTER_COUNT = size_t(R32::COUNT);
+        static const size_t WORD_REGISTER_COUNT = GENERAL_REGISTER_COUNT * 2 + size_t(R16::COUNT) - GENERAL_REGISTER_COUNT;
 
         union
         {
@@ -438,6 +4147,7 @@ namespace vx16
 #define VX16_DEFINE_REGISTER(NAME) \
     union                          \
     {                              \
+        dword_t m_e##NAME##x;      \
         word_t m_##NAME##x;        \
         struct                     \
         {                          \
@@ -453,10 +4163,19 @@ namespace vx16
 
 #undef VX16_DEFINE_REGISTER
 
-                word_t m_bp;
-                word_t m_si;
-                word_t m_di;
-                word_t m_sp;
+#define VX16_DEFINE_INDEX_REGISTER(NAME) \
+    union                                \
+    {                                    \
+        dword_t m_e##NAME;               \
+        word_t m_##NAME;                 \
+    }
+
+                VX16_DEFINE_INDEX_REGISTER(bp);
+                VX16_DEFINE_INDEX_REGISTER(si);
+                VX16_DEFINE_INDEX_REGISTER(di);
+                VX16_DEFINE_INDEX_REGISTER(sp);
+
+#undef VX16_DEFINE_INDEX_REGISTER
 
                 word_t m_cs;
                 word_t m_ds;
@@ -489,24 +4208,243 @@ namespace vx16
                 };
             };
 
-            byte_t m_registers8 [REGISTER_COUNT * 2];
-            word_t m_registers16[REGISTER_COUNT    ];
+            byte_t  m_registers8 [WORD_REGISTER_COUNT * 2];
+            word_t  m_registers16[WORD_REGISTER_COUNT    ];
+            dword_t m_registers32[GENERAL_REGISTER_COUNT ];
         };
 
-        void setValue(R8 reg, byte_t value)
+        // General purpose registers are double words, so R8 and R16 indices need to be adjusted
+
+        static size_t index(R8 reg)
         {
             const size_t index = static_cast<size_t>(reg);
-            m_registers8[index] = value;
+            return (index & ~size_t(1)) * 2 + (index & 1);
         }
 
-        void setValue(R16 reg, word_t value)
+        static size_t index(R16 reg)
         {
             const size_t index = static_cast<size_t>(reg);
-            m_registers16[index] = value;
+            return index < GENERAL_REGISTER_COUNT ? index * 2 : index + GENERAL_REGISTER_COUNT;
+        }
+
+        static size_t index(R32 reg)
+        {
+            return static_cast<size_t>(reg);
+        }
+
+        void setValue(R8 reg, byte_t value)
+        {
+            m_registers8[index(reg)] = value;
+        }
+
+        void setValue(R16 reg, word_t value)
+        {
+            m_registers16[index(reg)] = value;
+        }
+
+        void setValue(R32 reg, dword_t value)
+        {
+            m_registers32[index(reg)] = value;
+        }
+
+        void pushWord(word_t value)
+        {
+            m_sp -= 2;
+            m_memory->set(m_ss, m_sp, value);
+        }
+
+        word_t popWord()
+        {
+            const word_t value = m_memory->get<word_t>(m_ss, m_sp);
+            m_sp += 2;
+            return value;
+        }
+
+        void pushDword(dword_t value)
+        {
+            m_sp -= 4;
+            m_memory->set(m_ss, m_sp, value);
+        }
+
+        dword_t popDword()
+        {
+            const dword_t value = m_memory->get<dword_t>(m_ss, m_sp);
+            m_sp += 4;
+            return value;
+        }
+
+        static bool parity(byte_t value)
+        {
+            value ^= value >> 4;
+            value ^= value >> 2;
+            value ^= value >> 1;
+            return 0 == (value & 1);
+        }
+
+        template <typename T>
+        void setResultFlags(T result)
+        {
+            m_zf = 0 == result;
+            m_sf = (result >> (sizeof(T) * 8 - 1)) & 1;
+            m_pf = parity(static_cast<byte_t>(result));
+        }
+
+        template <typename T>
+        T addValues(T lhs, T rhs)
+        {
+            const T result = static_cast<T>(lhs + rhs);
+
+            m_cf = result < lhs;
+            m_of = (((lhs ^ result) & (rhs ^ result)) >> (sizeof(T) * 8 - 1)) & 1;
+            m_af = ((lhs ^ rhs ^ result) >> 4) & 1;
+            setResultFlags(result);
+
+            return result;
+        }
+
+        // Result is returned in signed type of double width
+        template <typename W, typename T>
+        W multiplySigned(T lhs, T rhs)
+        {
+            typedef typename std::make_signed<T>::type S;
+
+            const W result = W(S(lhs)) * W(S(rhs));
+            const bool overflow = result != W(S(T(result)));
+
+            m_cf = overflow;
+            m_of = overflow;
+
+            return result;
+        }
+
+        template <typename T>
+        T shiftLeft(T value, byte_t count)
+        {
+            static const unsigned BITS = sizeof(T) * 8;
+
+            count &= 0x1F;
+
+            if (0 == count)
+            {
+                return value;
+            }
+
+            const T result = count < BITS ? static_cast<T>(qword_t(value) << count) : 0;
+
+            m_cf = count <= BITS ? (value >> (BITS - count)) & 1 : 0;
+            m_of = ((result >> (BITS - 1)) ^ m_cf) & 1;
+            setResultFlags(result);
+
+            return result;
+        }
+
+        template <typename T>
+        void moveString()
+        {
+            m_memory->set(m_es, m_di, m_memory->get<T>(m_ds, m_si));
+
+            const word_t step = m_df ? word_t(0 - sizeof(T)) : word_t(sizeof(T));
+            m_si += step;
+            m_di += step;
+        }
+
+        template <typename T>
+        void repMoveString()
+        {
+            const size_t size = size_t(m_cx) * sizeof(T);
+
+            // Forward copy that doesn't wrap around is done at once unless element moves are observable
+            if (0 != size && !m_df
+                && m_si + size <= 0x10000 && m_di + size <= 0x10000
+                && m_memory->copy(m_es, m_di, m_ds, m_si, size))
+            {
+                m_si = static_cast<word_t>(m_si + size);
+                m_di = static_cast<word_t>(m_di + size);
+                m_cx = 0;
+                return;
+            }
+
+            for (; 0 != m_cx; --m_cx)
+            {
+                moveString<T>();
+            }
+        }
+
+        void enterFrame(CallKind kind, word_t returnSegment, word_t returnOffset VX16_SOURCE_LOCATION_PARAMETER)
+        {
+#ifdef VX16_PROFILER
+            m_callStack.push_back(CallFrame{ kind, m_ss, m_sp, returnSegment, returnOffset, m_profilerNode });
+            m_profilerNode = Profiler::enter(location, m_profilerNode);
+#else // !VX16_PROFILER
+            m_callStack.push_back(CallFrame{ kind, m_ss, m_sp, returnSegment, returnOffset });
+#endif // VX16_PROFILER
+        }
+
+        // Return removes the innermost frame of the same kind and stack position, and frames above it,
+        // return without such frame, e.g. to address pushed by guest code, leaves call stack intact
+        void leaveFrame(CallKind kind)
+        {
+            for (size_t depth = m_callStack.size(); depth > 0; --depth)
+            {
+                const CallFrame& frame = m_callStack[depth - 1];
+
+                if (kind != frame.m_kind || m_ss != frame.m_ss || m_sp != frame.m_sp)
+                {
+                    continue;
+                }
+
+                if (m_callStack.size() != depth)
+                {
+                    ++m_unmatchedReturns;
+                }
+
+#ifdef VX16_PROFILER
+                m_profilerNode = frame.m_profilerNode;
+#endif // VX16_PROFILER
+
+                m_callStack.erase(m_callStack.begin() + (depth - 1), m_callStack.end());
+                return;
+            }
+
+            ++m_unmatchedReturns;
         }
 
     };
 
+    // Templates used by most instructions, vx16 library instantiates them once for all its clients
+
+#define VX16_TEMPLATE_INSTANTIATIONS(EXTERN) \
+    EXTERN template byte_t Memory::get<byte_t>(word_t, word_t) const; \
+    EXTERN template word_t Memory::get<word_t>(word_t, word_t) const; \
+    EXTERN template dword_t Memory::get<dword_t>(word_t, word_t) const; \
+    EXTERN template qword_t Memory::get<qword_t>(word_t, word_t) const; \
+    EXTERN template void Memory::set<byte_t>(word_t, word_t, byte_t); \
+    EXTERN template void Memory::set<word_t>(word_t, word_t, word_t); \
+    EXTERN template void Memory::set<dword_t>(word_t, word_t, dword_t); \
+    EXTERN template void Memory::set<qword_t>(word_t, word_t, qword_t); \
+    EXTERN template void CPU::setResultFlags<byte_t>(byte_t); \
+    EXTERN template void CPU::setResultFlags<word_t>(word_t); \
+    EXTERN template void CPU::setResultFlags<dword_t>(dword_t); \
+    EXTERN template byte_t CPU::addValues<byte_t>(byte_t, byte_t); \
+    EXTERN template word_t CPU::addValues<word_t>(word_t, word_t); \
+    EXTERN template dword_t CPU::addValues<dword_t>(dword_t, dword_t); \
+    EXTERN template int16_t CPU::multiplySigned<int16_t, byte_t>(byte_t, byte_t); \
+    EXTERN template int32_t CPU::multiplySigned<int32_t, word_t>(word_t, word_t); \
+    EXTERN template int64_t CPU::multiplySigned<int64_t, dword_t>(dword_t, dword_t); \
+    EXTERN template byte_t CPU::shiftLeft<byte_t>(byte_t, byte_t); \
+    EXTERN template word_t CPU::shiftLeft<word_t>(word_t, byte_t); \
+    EXTERN template dword_t CPU::shiftLeft<dword_t>(dword_t, byte_t); \
+    EXTERN template void CPU::moveString<byte_t>(); \
+    EXTERN template void CPU::moveString<word_t>(); \
+    EXTERN template void CPU::moveString<dword_t>(); \
+    EXTERN template void CPU::repMoveString<byte_t>(); \
+    EXTERN template void CPU::repMoveString<word_t>(); \
+    EXTERN template void CPU::repMoveString<dword_t>();
+
+#if defined VX16_LIBRARY && !defined VX16_IMPLEMENTATION
+    VX16_TEMPLATE_INSTANTIATIONS(extern)
+#endif
+
 } // namespace vx16
 
 #endif // !VX16_H_INCLUDED
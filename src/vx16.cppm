@@ -0,0 +1,55 @@
+/*
+ * vx16: Source Code Level Virtual x86 16-bit CPU
+ * Copyright (C) 2016  Alexey Lysiuk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// vx16 as C++20 module, it contains definitions of everything and doesn't need vx16 library
+// With VX16_PROFILER defined, GCC 12 requires <source_location> to be included before import vx16
+
+module;
+
+// Standard headers used by vx16.h, they must not be attached to the module
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <set>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef VX16_PROFILER
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <source_location>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#endif // VX16_PROFILER
+
+export module vx16;
+
+#define VX16_IMPLEMENTATION
+#define VX16_EXPORT export
+#include "vx16.h"
@@ -0,0 +1,186 @@
+# Build time benchmark of code ported to vx16
+#
+# Generates project with FILES translation units of LINES instructions each and builds it
+# with vx16 used as plain header, as library, and as library with precompiled header.
+# Full build and rebuild after change of one translation unit are timed for each configuration.
+#
+# Usage: cmake [-DFILES=16] [-DLINES=200] [-DBUILD_TYPE=Debug] [-DJOBS=N] -P test/vx16buildbench.cmake
+# or build vx16buildbench target
+
+cmake_minimum_required(VERSION 3.16)
+
+if(NOT DEFINED VX16_SOURCE_DIR)
+    get_filename_component(VX16_SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+endif()
+
+if(NOT DEFINED BENCHMARK_DIR)
+    set(BENCHMARK_DIR "${CMAKE_CURRENT_BINARY_DIR}/vx16buildbench")
+endif()
+
+if(NOT DEFINED FILES)
+    set(FILES 16)
+endif()
+
+if(NOT DEFINED LINES)
+    set(LINES 200)
+endif()
+
+if(NOT DEFINED BUILD_TYPE)
+    set(BUILD_TYPE Debug)
+endif()
+
+if(NOT DEFINED JOBS)
+    cmake_host_system_information(RESULT JOBS QUERY NUMBER_OF_LOGICAL_CORES)
+endif()
+
+set(CONFIGURE_ARGUMENTS "-DCMAKE_BUILD_TYPE=${BUILD_TYPE}")
+
+if(DEFINED GENERATOR)
+    list(APPEND CONFIGURE_ARGUMENTS -G "${GENERATOR}")
+endif()
+
+if(DEFINED CXX_COMPILER)
+    list(APPEND CONFIGURE_ARGUMENTS "-DCMAKE_CXX_COMPILER=${CXX_COMPILER}")
+endif()
+
+# Instruction mix of ported code, @V@ is replaced with varying value
+
+set(INSTRUCTIONS
+    "cpu.mov(R16::AX, @V@)"
+    "cpu.mov(R8::BL, R8::AL)"
+    "cpu.add(R16::AX, R16::BX)"
+    "cpu.mov(cpu.wordPtr(@V@), R16::AX)"
+    "cpu.mov(R16::DX, cpu.wordPtr(@V@))"
+    "cpu.push(R16::DX)"
+    "cpu.pop(R16::CX)"
+    "cpu.add(R32::EAX, @V@)"
+    "cpu.imul(R32::EBX)"
+    "cpu.shl(R16::DX, 3)"
+    "cpu.fld(cpu.qwordPtr(@V@))"
+    "cpu.fmul(cpu.qwordPtr(@V@))"
+    "cpu.fstp(cpu.qwordPtr(@V@))"
+    "cpu.movsw()"
+)
+list(LENGTH INSTRUCTIONS INSTRUCTION_COUNT)
+
+set(SOURCE_DIR "${BENCHMARK_DIR}/source")
+set(SOURCE_FILES main.cpp)
+set(DECLARATIONS "")
+set(CALLS "")
+
+math(EXPR LAST_FILE "${FILES} - 1")
+math(EXPR LAST_LINE "${LINES} - 1")
+
+foreach(file RANGE ${LAST_FILE})
+    set(content "#include \"vx16.h\"\n\nusing namespace vx16;\n\nvoid ported${file}(CPU& cpu)\n{\n")
+
+    foreach(line RANGE ${LAST_LINE})
+        math(EXPR index "(${file} + ${line}) % ${INSTRUCTION_COUNT}")
+        math(EXPR value "(${file} * 7919 + ${line} * 104729) % 0xFFF0")
+        list(GET INSTRUCTIONS ${index} instruction)
+        string(REPLACE "@V@" "${value}" instruction "${instruction}")
+        string(APPEND content "    ${instruction};\n")
+    endforeach()
+
+    string(APPEND content "}\n")
+    file(WRITE "${SOURCE_DIR}/ported${file}.cpp" "${content}")
+
+    list(APPEND SOURCE_FILES ported${file}.cpp)
+    string(APPEND DECLARATIONS "void ported${file}(vx16::CPU& cpu);\n")
+    string(APPEND CALLS "    ported${file}(cpu);\n")
+endforeach()
+
+file(WRITE "${SOURCE_DIR}/main.cpp"
+    "#include \"vx16.h\"\n\n${DECLARATIONS}\nint main()\n{\n"
+    "    vx16::Memory memory;\n    vx16::CPU cpu(&memory);\n\n${CALLS}}\n")
+
+string(REPLACE ";" " " SOURCE_FILES "${SOURCE_FILES}")
+file(WRITE "${SOURCE_DIR}/CMakeLists.txt"
+    "cmake_minimum_required(VERSION 3.16)\n"
+    "project(vx16buildbench CXX)\n"
+    "add_subdirectory(\"${VX16_SOURCE_DIR}\" vx16)\n"
+    "add_executable(vx16buildbench ${SOURCE_FILES})\n"
+    "target_link_libraries(vx16buildbench vx16)\n")
+
+# Milliseconds since epoch, fraction of second is available in CMake 3.23 and newer
+function(current_time RESULT)
+    if(CMAKE_VERSION VERSION_LESS 3.23)
+        string(TIMESTAMP seconds "%s" UTC)
+        math(EXPR milliseconds "${seconds} * 1000")
+    else()
+        string(TIMESTAMP time "%s %f" UTC)
+        separate_arguments(time)
+        list(GET time 0 seconds)
+        list(GET time 1 microseconds)
+        string(REGEX REPLACE "^0+([0-9])" "\\1" microseconds "${microseconds}")
+        math(EXPR milliseconds "${seconds} * 1000 + ${microseconds} / 1000")
+    endif()
+
+    set(${RESULT} ${milliseconds} PARENT_SCOPE)
+endfunction()
+
+function(timed_build BINARY_DIR RESULT)
+    current_time(start)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} --build "${BINARY_DIR}" -j ${JOBS}
+        OUTPUT_QUIET
+        RESULT_VARIABLE status)
+    current_time(finish)
+
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "Failed to build ${BINARY_DIR}")
+    endif()
+
+    math(EXPR elapsed "${finish} - ${start}")
+    set(${RESULT} ${elapsed} PARENT_SCOPE)
+endfunction()
+
+function(format_time MILLISECONDS RESULT)
+    math(EXPR seconds "${MILLISECONDS} / 1000")
+    math(EXPR fraction "${MILLISECONDS} % 1000")
+    string(LENGTH "${fraction}" length)
+
+    while(length LESS 3)
+        set(fraction "0${fraction}")
+        string(LENGTH "${fraction}" length)
+    endwhile()
+
+    set(${RESULT} "${seconds}.${fraction} s" PARENT_SCOPE)
+endfunction()
+
+set(CONFIGURATIONS header library pch)
+set(header_OPTIONS -DVX16_LIBRARY=OFF -DVX16_PRECOMPILED_HEADER=OFF)
+set(header_NAME "header only         ")
+set(library_OPTIONS -DVX16_LIBRARY=ON -DVX16_PRECOMPILED_HEADER=OFF)
+set(library_NAME "library             ")
+set(pch_OPTIONS -DVX16_LIBRARY=ON -DVX16_PRECOMPILED_HEADER=ON)
+set(pch_NAME "library + PCH       ")
+
+message(STATUS "Building ${FILES} files of ${LINES} instructions, ${BUILD_TYPE} configuration, ${JOBS} jobs")
+
+set(REPORT "")
+
+foreach(configuration ${CONFIGURATIONS})
+    set(binary_dir "${BENCHMARK_DIR}/${configuration}")
+    file(REMOVE_RECURSE "${binary_dir}")
+
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${binary_dir}" ${CONFIGURE_ARGUMENTS} ${${configuration}_OPTIONS}
+        OUTPUT_QUIET
+        RESULT_VARIABLE status)
+
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "Failed to configure ${binary_dir}")
+    endif()
+
+    timed_build("${binary_dir}" full)
+
+    file(TOUCH "${SOURCE_DIR}/ported0.cpp")
+    timed_build("${binary_dir}" incremental)
+
+    format_time(${full} full)
+    format_time(${incremental} incremental)
+    string(APPEND REPORT "\n  ${${configuration}_NAME}full ${full}, one file changed ${incremental}")
+endforeach()
+
+message(STATUS "Build times:${REPORT}")
@@ -0,0 +1,1236 @@
+/*
+ * vx16: Source Code Level Virtual x86 16-bit CPU
+ * Copyright (C) 2016  Alexey Lysiuk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Differential fuzzer: random instruction sequences are executed by vx16::CPU
+// and by a straightforward reference model, then complete states are compared
+//
+// Usage: vx16fuzz [cases per thread] [thread count] [seed]
+
+#include "vx16.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace vx16;
+
+namespace
+{
+
+    const size_t PAGE_COUNT = 3;
+    const size_t PAGE_SIZE = 64 * 1024;
+    const size_t MAX_CASE_LENGTH = 64;
+    const size_t FULL_COMPARE_INTERVAL = 1024;
+
+    // Registers in R16 order, i.e. AX, BX, CX, DX, BP, SI, DI, SP, CS, DS, SS, ES, FS, GS, FLAGS
+    const size_t REF_REGISTER_COUNT = size_t(R16::COUNT);
+    const size_t REF_GENERAL_REGISTER_COUNT = size_t(R32::COUNT);
+
+    const word_t FLAG_CF = 0x0001;
+    const word_t FLAG_PF = 0x0004;
+    const word_t FLAG_AF = 0x0010;
+    const word_t FLAG_ZF = 0x0040;
+    const word_t FLAG_SF = 0x0080;
+    const word_t FLAG_DF = 0x0400;
+    const word_t FLAG_OF = 0x0800;
+
+    // Maximum element count of generated rep prefixed operations
+    const word_t MAX_REP_COUNT = 0x1000;
+
+    enum class OpKind : byte_t
+    {
+        MOV_R8_IMM,
+        MOV_R8_R8,
+        MOV_R16_IMM,
+        MOV_R16_R16,
+        MOV_NEAR8_IMM,
+        MOV_NEAR16_IMM,
+        MOV_NEAR8_R8,
+        MOV_NEAR16_R16,
+        MOV_R8_NEAR8,
+        MOV_R16_NEAR16,
+        MOV_FAR8_IMM,
+        MOV_FAR16_IMM,
+        MOV_FAR8_R8,
+        MOV_FAR16_R16,
+        MOV_R8_FAR8,
+        MOV_R16_FAR16,
+        CWD,
+        XLAT,
+        PUSH_IMM,
+        PUSH_R16,
+        PUSH_NEAR16,
+        PUSH_FAR16,
+        POP,
+        POP_R16,
+        POP_NEAR16,
+        POP_FAR16,
+        PUSHA,
+        POPA,
+        ENTER,
+        LEAVE,
+        MOV_R32_IMM,
+        MOV_R32_R32,
+        MOV_NEAR32_IMM,
+        MOV_NEAR32_R32,
+        MOV_R32_NEAR32,
+        MOV_FAR32_IMM,
+        MOV_FAR32_R32,
+        MOV_R32_FAR32,
+        PUSHD_IMM,
+        PUSH_R32,
+        PUSH_FAR32,
+        POPD,
+        POP_R32,
+        POP_FAR32,
+        ADD_R8_IMM,
+        ADD_R8_R8,
+        ADD_R16_IMM,
+        ADD_R16_R16,
+        ADD_R32_IMM,
+        ADD_R32_R32,
+        ADD_R16_FAR16,
+        ADD_FAR16_R16,
+        ADD_R32_FAR32,
+        ADD_FAR32_R32,
+        IMUL_R8,
+        IMUL_R16,
+        IMUL_R32,
+        IMUL_R16_R16,
+        IMUL_R32_R32,
+        IMUL_R16_R16_IMM,
+        IMUL_R32_R32_IMM,
+        SHL_R8_IMM,
+        SHL_R16_IMM,
+        SHL_R32_IMM,
+        SHL_R8_CL,
+        SHL_R16_CL,
+        SHL_R32_CL,
+        MOVSB,
+        MOVSW,
+        MOVSD,
+        REP_MOVSB,
+        REP_MOVSW,
+        REP_MOVSD,
+
+        COUNT
+    };
+
+    const char* const OP_NAMES[] =
+    {
+        "mov r8, imm",
+        "mov r8, r8",
+        "mov r16, imm",
+        "mov r16, r16",
+        "mov near byte, imm",
+        "mov near word, imm",
+        "mov near byte, r8",
+        "mov near word, r16",
+        "mov r8, near byte",
+        "mov r16, near word",
+        "mov far byte, imm",
+        "mov far word, imm",
+        "mov far byte, r8",
+        "mov far word, r16",
+        "mov r8, far byte",
+        "mov r16, far word",
+        "cwd",
+        "xlat",
+        "push imm",
+        "push r16",
+        "push near word",
+        "push far word",
+        "pop",
+        "pop r16",
+        "pop near word",
+        "pop far word",
+        "pusha",
+        "popa",
+        "enter",
+        "leave",
+        "mov r32, imm",
+        "mov r32, r32",
+        "mov near dword, imm",
+        "mov near dword, r32",
+        "mov r32, near dword",
+        "mov far dword, imm",
+        "mov far dword, r32",
+        "mov r32, far dword",
+        "push dword imm",
+        "push r32",
+        "push far dword",
+        "pop dword",
+        "pop r32",
+        "pop far dword",
+        "add r8, imm",
+        "add r8, r8",
+        "add r16, imm",
+        "add r16, r16",
+        "add r32, imm",
+        "add r32, r32",
+        "add r16, far word",
+        "add far word, r16",
+        "add r32, far dword",
+        "add far dword, r32",
+        "imul r8",
+        "imul r16",
+        "imul r32",
+        "imul r16, r16",
+        "imul r32, r32",
+        "imul r16, r16, imm",
+        "imul r32, r32, imm",
+        "shl r8, imm",
+        "shl r16, imm",
+        "shl r32, imm",
+        "shl r8, cl",
+        "shl r16, cl",
+        "shl r32, cl",
+        "movsb",
+        "movsw",
+        "movsd",
+        "rep movsb",
+        "rep movsw",
+        "rep movsd",
+    };
+
+    static_assert(sizeof OP_NAMES / sizeof OP_NAMES[0] == size_t(OpKind::COUNT), "Operation names mismatch");
+
+    struct Op
+    {
+        OpKind m_kind;
+        byte_t m_reg1;   // destination register, or segment register of far pointer
+        byte_t m_reg2;   // source register
+        word_t m_value1; // immediate or offset
+        word_t m_value2; // immediate or segment value
+        dword_t m_imm32; // 32-bit immediate
+    };
+
+    bool isSegment(size_t reg)
+    {
+        return reg >= size_t(R16::CS) && reg <= size_t(R16::GS);
+    }
+
+    // Deliberately naive model of the CPU operating on individual bytes
+    class RefMachine
+    {
+    public:
+        RefMachine()
+        : m_pages(PAGE_COUNT, std::vector<byte_t>(PAGE_SIZE, 0))
+        {
+            for (word_t& reg : m_registers)
+            {
+                reg = 0;
+            }
+
+            for (word_t& reg : m_high)
+            {
+                reg = 0;
+            }
+
+            m_registers[size_t(R16::DS)] = 0;
+            m_registers[size_t(R16::SS)] = 1;
+            m_registers[size_t(R16::FLAGS)] = 2;
+        }
+
+        word_t reg16(size_t index) const
+        {
+            return m_registers[index];
+        }
+
+        byte_t reg8(size_t index) const
+        {
+            const word_t value = m_registers[index / 2];
+            return byte_t(index % 2 ? value >> 8 : value);
+        }
+
+        dword_t reg32(size_t index) const
+        {
+            return dword_t(m_registers[index] | (dword_t(m_high[index]) << 16));
+        }
+
+        byte_t byteAt(size_t segment, size_t offset) const
+        {
+            return m_pages[segment][offset];
+        }
+
+        const std::vector<std::pair<word_t, word_t>>& touched() const
+        {
+            return m_touched;
+        }
+
+        void clearTouched()
+        {
+            m_touched.clear();
+        }
+
+        void apply(const Op& op)
+        {
+            const word_t ds = m_registers[size_t(R16::DS)];
+            const word_t farSegment = m_registers[op.m_reg1];
+
+            switch (op.m_kind)
+            {
+            case OpKind::MOV_R8_IMM:     setReg8(op.m_reg1, byte_t(op.m_value1)); break;
+            case OpKind::MOV_R8_R8:      setReg8(op.m_reg1, reg8(op.m_reg2)); break;
+            case OpKind::MOV_R16_IMM:    m_registers[op.m_reg1] = op.m_value1; break;
+            case OpKind::MOV_R16_R16:    m_registers[op.m_reg1] = m_registers[op.m_reg2]; break;
+            case OpKind::MOV_NEAR8_IMM:  write8(ds, op.m_value1, byte_t(op.m_value2)); break;
+            case OpKind::MOV_NEAR16_IMM: write16(ds, op.m_value1, op.m_value2); break;
+            case OpKind::MOV_NEAR8_R8:   write8(ds, op.m_value1, reg8(op.m_reg2)); break;
+            case OpKind::MOV_NEAR16_R16: write16(ds, op.m_value1, m_registers[op.m_reg2]); break;
+            case OpKind::MOV_R8_NEAR8:   setReg8(op.m_reg2, read8(ds, op.m_value1)); break;
+            case OpKind::MOV_R16_NEAR16: m_registers[op.m_reg2] = read16(ds, op.m_value1); break;
+            case OpKind::MOV_FAR8_IMM:   write8(farSegment, op.m_value1, byte_t(op.m_value2)); break;
+            case OpKind::MOV_FAR16_IMM:  write16(farSegment, op.m_value1, op.m_value2); break;
+            case OpKind::MOV_FAR8_R8:    write8(farSegment, op.m_value1, reg8(op.m_reg2)); break;
+            case OpKind::MOV_FAR16_R16:  write16(farSegment, op.m_value1, m_registers[op.m_reg2]); break;
+            case OpKind::MOV_R8_FAR8:    setReg8(op.m_reg2, read8(farSegment, op.m_value1)); break;
+            case OpKind::MOV_R16_FAR16:  m_registers[op.m_reg2] = read16(farSegment, op.m_value1); break;
+
+            case OpKind::CWD:
+                m_registers[size_t(R16::DX)] = m_registers[size_t(R16::AX)] >= 0x8000 ? 0xFFFF : 0;
+                break;
+
+            case OpKind::XLAT:
+                setReg8(size_t(R8::AL), read8(ds, word_t(m_registers[size_t(R16::BX)] + reg8(size_t(R8::AL)))));
+                break;
+
+            case OpKind::PUSH_IMM:    push(op.m_value1); break;
+            case OpKind::PUSH_R16:    push(m_registers[op.m_reg2]); break;
+            case OpKind::PUSH_NEAR16: push(read16(ds, op.m_value1)); break;
+            case OpKind::PUSH_FAR16:  push(read16(op.m_value2, op.m_value1)); break;
+            case OpKind::POP:         pop(); break;
+            case OpKind::POP_R16:     m_registers[op.m_reg1] = pop(); break;
+
+            case OpKind::POP_NEAR16:
+            {
+                const word_t value = pop();
+                write16(ds, op.m_value1, value);
+                break;
+            }
+
+            case OpKind::POP_FAR16:
+            {
+                const word_t value = pop();
+                write16(op.m_value2, op.m_value1, value);
+                break;
+            }
+
+            case OpKind::PUSHA:
+            {
+                const word_t sp = m_registers[size_t(R16::SP)];
+                const R16 order[] = { R16::AX, R16::CX, R16::DX, R16::BX, R16::SP, R16::BP, R16::SI, R16::DI };
+
+                for (R16 reg : order)
+                {
+                    push(R16::SP == reg ? sp : m_registers[size_t(reg)]);
+                }
+
+                break;
+            }
+
+            case OpKind::POPA:
+            {
+                const R16 order[] = { R16::DI, R16::SI, R16::BP, R16::SP, R16::BX, R16::DX, R16::CX, R16::AX };
+
+                for (R16 reg : order)
+                {
+                    const word_t value = pop();
+
+                    if (R16::SP != reg)
+                    {
+                        m_registers[size_t(reg)] = value;
+                    }
+                }
+
+                break;
+            }
+
+            case OpKind::ENTER:
+                push(m_registers[size_t(R16::BP)]);
+                m_registers[size_t(R16::BP)] = m_registers[size_t(R16::SP)];
+                m_registers[size_t(R16::SP)] = word_t(m_registers[size_t(R16::SP)] - op.m_value1);
+                break;
+
+            case OpKind::LEAVE:
+                m_registers[size_t(R16::SP)] = m_registers[size_t(R16::BP)];
+                m_registers[size_t(R16::BP)] = pop();
+                break;
+
+            case OpKind::MOV_R32_IMM:    setReg32(op.m_reg1, op.m_imm32); break;
+            case OpKind::MOV_R32_R32:    setReg32(op.m_reg1, reg32(op.m_reg2)); break;
+            case OpKind::MOV_NEAR32_IMM: write32(ds, op.m_value1, op.m_imm32); break;
+            case OpKind::MOV_NEAR32_R32: write32(ds, op.m_value1, reg32(op.m_reg2)); break;
+            case OpKind::MOV_R32_NEAR32: setReg32(op.m_reg2, read32(ds, op.m_value1)); break;
+            case OpKind::MOV_FAR32_IMM:  write32(farSegment, op.m_value1, op.m_imm32); break;
+            case OpKind::MOV_FAR32_R32:  write32(farSegment, op.m_value1, reg32(op.m_reg2)); break;
+            case OpKind::MOV_R32_FAR32:  setReg32(op.m_reg2, read32(farSegment, op.m_value1)); break;
+
+            case OpKind::PUSHD_IMM:  push32(op.m_imm32); break;
+            case OpKind::PUSH_R32:   push32(reg32(op.m_reg2)); break;
+            case OpKind::PUSH_FAR32: push32(read32(op.m_value2, op.m_value1)); break;
+            case OpKind::POPD:       pop32(); break;
+            case OpKind::POP_R32:    setReg32(op.m_reg1, pop32()); break;
+
+            case OpKind::POP_FAR32:
+            {
+                const dword_t value = pop32();
+                write32(op.m_value2, op.m_value1, value);
+                break;
+            }
+
+            case OpKind::ADD_R8_IMM:  setReg8(op.m_reg1, byte_t(add(reg8(op.m_reg1), byte_t(op.m_value1), 8))); break;
+            case OpKind::ADD_R8_R8:   setReg8(op.m_reg1, byte_t(add(reg8(op.m_reg1), reg8(op.m_reg2), 8))); break;
+            case OpKind::ADD_R16_IMM: m_registers[op.m_reg1] = word_t(add(m_registers[op.m_reg1], op.m_value1, 16)); break;
+            case OpKind::ADD_R16_R16: m_registers[op.m_reg1] = word_t(add(m_registers[op.m_reg1], m_registers[op.m_reg2], 16)); break;
+            case OpKind::ADD_R32_IMM: setReg32(op.m_reg1, dword_t(add(reg32(op.m_reg1), op.m_imm32, 32))); break;
+            case OpKind::ADD_R32_R32: setReg32(op.m_reg1, dword_t(add(reg32(op.m_reg1), reg32(op.m_reg2), 32))); break;
+
+            case OpKind::ADD_R16_FAR16:
+                m_registers[op.m_reg2] = word_t(add(m_registers[op.m_reg2], read16(farSegment, op.m_value1), 16));
+                break;
+
+            case OpKind::ADD_FAR16_R16:
+                write16(farSegment, op.m_value1, word_t(add(read16(farSegment, op.m_value1), m_registers[op.m_reg2], 16)));
+                break;
+
+            case OpKind::ADD_R32_FAR32:
+                setReg32(op.m_reg2, dword_t(add(reg32(op.m_reg2), read32(farSegment, op.m_value1), 32)));
+                break;
+
+            case OpKind::ADD_FAR32_R32:
+                write32(farSegment, op.m_value1, dword_t(add(read32(farSegment, op.m_value1), reg32(op.m_reg2), 32)));
+                break;
+
+            case OpKind::IMUL_R8:
+                m_registers[size_t(R16::AX)] = word_t(multiply(reg8(size_t(R8::AL)), reg8(op.m_reg2), 8));
+                break;
+
+            case OpKind::IMUL_R16:
+            {
+                const uint64_t product = multiply(m_registers[size_t(R16::AX)], m_registers[op.m_reg2], 16);
+                m_registers[size_t(R16::AX)] = word_t(product);
+                m_registers[size_t(R16::DX)] = word_t(product >> 16);
+                break;
+            }
+
+            case OpKind::IMUL_R32:
+            {
+                const uint64_t product = multiply(reg32(size_t(R32::EAX)), reg32(op.m_reg2), 32);
+                setReg32(size_t(R32::EAX), dword_t(product));
+                setReg32(size_t(R32::EDX), dword_t(product >> 32));
+                break;
+            }
+
+            case OpKind::IMUL_R16_R16:     m_registers[op.m_reg1] = word_t(multiply(m_registers[op.m_reg1], m_registers[op.m_reg2], 16)); break;
+            case OpKind::IMUL_R32_R32:     setReg32(op.m_reg1, dword_t(multiply(reg32(op.m_reg1), reg32(op.m_reg2), 32))); break;
+            case OpKind::IMUL_R16_R16_IMM: m_registers[op.m_reg1] = word_t(multiply(m_registers[op.m_reg2], op.m_value1, 16)); break;
+            case OpKind::IMUL_R32_R32_IMM: setReg32(op.m_reg1, dword_t(multiply(reg32(op.m_reg2), op.m_imm32, 32))); break;
+
+            case OpKind::SHL_R8_IMM:  setReg8(op.m_reg1, byte_t(shiftLeft(reg8(op.m_reg1), byte_t(op.m_value1), 8))); break;
+            case OpKind::SHL_R16_IMM: m_registers[op.m_reg1] = word_t(shiftLeft(m_registers[op.m_reg1], byte_t(op.m_value1), 16)); break;
+            case OpKind::SHL_R32_IMM: setReg32(op.m_reg1, dword_t(shiftLeft(reg32(op.m_reg1), byte_t(op.m_value1), 32))); break;
+            case OpKind::SHL_R8_CL:   setReg8(op.m_reg1, byte_t(shiftLeft(reg8(op.m_reg1), reg8(size_t(R8::CL)), 8))); break;
+            case OpKind::SHL_R16_CL:  m_registers[op.m_reg1] = word_t(shiftLeft(m_registers[op.m_reg1], reg8(size_t(R8::CL)), 16)); break;
+            case OpKind::SHL_R32_CL:  setReg32(op.m_reg1, dword_t(shiftLeft(reg32(op.m_reg1), reg8(size_t(R8::CL)), 32))); break;
+
+            case OpKind::MOVSB: moveString(1); break;
+            case OpKind::MOVSW: moveString(2); break;
+            case OpKind::MOVSD: moveString(4); break;
+
+            case OpKind::REP_MOVSB:
+            case OpKind::REP_MOVSW:
+            case OpKind::REP_MOVSD:
+            {
+                const size_t size = OpKind::REP_MOVSB == op.m_kind ? 1 : OpKind::REP_MOVSW == op.m_kind ? 2 : 4;
+
+                for (word_t& cx = m_registers[size_t(R16::CX)]; 0 != cx; --cx)
+                {
+                    moveString(size);
+                }
+
+                break;
+            }
+
+            default:
+                assert(!"unknown operation");
+            }
+        }
+
+    private:
+        std::vector<std::vector<byte_t>> m_pages;
+        word_t m_registers[REF_REGISTER_COUNT];
+        word_t m_high[REF_GENERAL_REGISTER_COUNT]; // upper halves of 32-bit registers
+        std::vector<std::pair<word_t, word_t>> m_touched;
+
+        void setReg8(size_t index, byte_t value)
+        {
+            word_t& reg = m_registers[index / 2];
+            reg = index % 2 ? word_t((reg & 0x00FF) | (value << 8)) : word_t((reg & 0xFF00) | value);
+        }
+
+        byte_t read8(word_t segment, word_t offset) const
+        {
+            return m_pages[segment][offset];
+        }
+
+        word_t read16(word_t segment, word_t offset) const
+        {
+            return word_t(read8(segment, offset) | (read8(segment, offset + 1) << 8));
+        }
+
+        void write8(word_t segment, word_t offset, byte_t value)
+        {
+            m_pages[segment][offset] = value;
+            m_touched.emplace_back(segment, offset);
+        }
+
+        void write16(word_t segment, word_t offset, word_t value)
+        {
+            write8(segment, offset, byte_t(value));
+            write8(segment, offset + 1, byte_t(value >> 8));
+        }
+
+        void push(word_t value)
+        {
+            word_t& sp = m_registers[size_t(R16::SP)];
+            sp -= 2;
+            write16(m_registers[size_t(R16::SS)], sp, value);
+        }
+
+        word_t pop()
+        {
+            word_t& sp = m_registers[size_t(R16::SP)];
+            const word_t value = read16(m_registers[size_t(R16::SS)], sp);
+            sp += 2;
+            return value;
+        }
+
+        void setReg32(size_t index, dword_t value)
+        {
+            m_registers[index] = word_t(value);
+            m_high[index] = word_t(value >> 16);
+        }
+
+        dword_t read32(word_t segment, word_t offset) const
+        {
+            return dword_t(read16(segment, offset) | (dword_t(read16(segment, offset + 2)) << 16));
+        }
+
+        void write32(word_t segment, word_t offset, dword_t value)
+        {
+            write16(segment, offset, word_t(value));
+            write16(segment, offset + 2, word_t(value >> 16));
+        }
+
+        void push32(dword_t value)
+        {
+            word_t& sp = m_registers[size_t(R16::SP)];
+            sp -= 4;
+            write32(m_registers[size_t(R16::SS)], sp, value);
+        }
+
+        dword_t pop32()
+        {
+            word_t& sp = m_registers[size_t(R16::SP)];
+            const dword_t value = read32(m_registers[size_t(R16::SS)], sp);
+            sp += 4;
+            return value;
+        }
+
+        void setFlag(word_t flag, bool value)
+        {
+            word_t& flags = m_registers[size_t(R16::FLAGS)];
+            flags = value ? word_t(flags | flag) : word_t(flags & ~flag);
+        }
+
+        static int64_t toSigned(uint64_t value, unsigned bits)
+        {
+            const uint64_t half = uint64_t(1) << (bits - 1);
+            return value >= half ? int64_t(value) - int64_t(half * 2) : int64_t(value);
+        }
+
+        void setResultFlags(uint64_t result, unsigned bits)
+        {
+            unsigned ones = 0;
+
+            for (unsigned i = 0; i < 8; ++i)
+            {
+                ones += (result >> i) & 1;
+            }
+
+            setFlag(FLAG_ZF, 0 == result);
+            setFlag(FLAG_SF, 0 != (result >> (bits - 1)));
+            setFlag(FLAG_PF, 0 == ones % 2);
+        }
+
+        uint64_t add(uint64_t lhs, uint64_t rhs, unsigned bits)
+        {
+            const uint64_t mask = (uint64_t(1) << bits) - 1;
+            const uint64_t result = (lhs + rhs) & mask;
+
+            setFlag(FLAG_CF, lhs + rhs > mask);
+            setFlag(FLAG_OF, toSigned(lhs, bits) + toSigned(rhs, bits) != toSigned(result, bits));
+            setFlag(FLAG_AF, (lhs & 0xF) + (rhs & 0xF) > 0xF);
+            setResultFlags(result, bits);
+
+            return result;
+        }
+
+        // Returns double width product
+        uint64_t multiply(uint64_t lhs, uint64_t rhs, unsigned bits)
+        {
+            const int64_t product = toSigned(lhs, bits) * toSigned(rhs, bits);
+            const uint64_t mask = (uint64_t(1) << bits) - 1;
+            const bool overflow = product != toSigned(uint64_t(product) & mask, bits);
+
+            setFlag(FLAG_CF, overflow);
+            setFlag(FLAG_OF, overflow);
+
+            return uint64_t(product);
+        }
+
+        uint64_t shiftLeft(uint64_t value, byte_t count, unsigned bits)
+        {
+            count &= 0x1F;
+
+            if (0 == count)
+            {
+                return value;
+            }
+
+            const uint64_t mask = (uint64_t(1) << bits) - 1;
+            bool carry = false;
+
+            for (byte_t i = 0; i < count; ++i)
+            {
+                carry = 0 != (value >> (bits - 1));
+                value = (value << 1) & mask;
+            }
+
+            setFlag(FLAG_CF, carry);
+            setFlag(FLAG_OF, (0 != (value >> (bits - 1))) != carry);
+            setResultFlags(value, bits);
+
+            return value;
+        }
+
+        void moveString(size_t size)
+        {
+            word_t& si = m_registers[size_t(R16::SI)];
+            word_t& di = m_registers[size_t(R16::DI)];
+            byte_t element[4];
+
+            for (size_t i = 0; i < size; ++i)
+            {
+                element[i] = read8(m_registers[size_t(R16::DS)], word_t(si + i));
+            }
+
+            for (size_t i = 0; i < size; ++i)
+            {
+                write8(m_registers[size_t(R16::ES)], word_t(di + i), element[i]);
+            }
+
+            const bool backward = 0 != (m_registers[size_t(R16::FLAGS)] & FLAG_DF);
+            si = word_t(backward ? si - size : si + size);
+            di = word_t(backward ? di - size : di + size);
+        }
+    };
+
+    void apply(CPU& cpu, const Op& op)
+    {
+        const R8 reg8Dst = R8(op.m_reg1);
+        const R8 reg8Src = R8(op.m_reg2);
+        const R16 reg16Dst = R16(op.m_reg1);
+        const R16 reg16Src = R16(op.m_reg2);
+        const byte_t imm8 = byte_t(op.m_value2);
+        const NearBytePtr nearByte = { op.m_value1 };
+        const NearWordPtr nearWord = { op.m_value1 };
+        const FarBytePtr farByte = cpu.bytePtr(reg16Dst, op.m_value1);
+        const FarWordPtr farWord = cpu.wordPtr(reg16Dst, op.m_value1);
+        const R32 reg32Dst = R32(op.m_reg1);
+        const R32 reg32Src = R32(op.m_reg2);
+        const NearDwordPtr nearDword = { op.m_value1 };
+        const FarDwordPtr farDword = cpu.dwordPtr(reg16Dst, op.m_value1);
+
+        switch (op.m_kind)
+        {
+        case OpKind::MOV_R8_IMM:     cpu.mov(reg8Dst, byte_t(op.m_value1)); break;
+        case OpKind::MOV_R8_R8:      cpu.mov(reg8Dst, reg8Src); break;
+        case OpKind::MOV_R16_IMM:    cpu.mov(reg16Dst, op.m_value1); break;
+        case OpKind::MOV_R16_R16:    cpu.mov(reg16Dst, reg16Src); break;
+        case OpKind::MOV_NEAR8_IMM:  cpu.mov(nearByte, imm8); break;
+        case OpKind::MOV_NEAR16_IMM: cpu.mov(nearWord, op.m_value2); break;
+        case OpKind::MOV_NEAR8_R8:   cpu.mov(nearByte, reg8Src); break;
+        case OpKind::MOV_NEAR16_R16: cpu.mov(nearWord, reg16Src); break;
+        case OpKind::MOV_R8_NEAR8:   cpu.mov(reg8Src, nearByte); break;
+        case OpKind::MOV_R16_NEAR16: cpu.mov(reg16Src, nearWord); break;
+        case OpKind::MOV_FAR8_IMM:   cpu.mov(farByte, imm8); break;
+        case OpKind::MOV_FAR16_IMM:  cpu.mov(farWord, op.m_value2); break;
+        case OpKind::MOV_FAR8_R8:    cpu.mov(farByte, reg8Src); break;
+        case OpKind::MOV_FAR16_R16:  cpu.mov(farWord, reg16Src); break;
+        case OpKind::MOV_R8_FAR8:    cpu.mov(reg8Src, farByte); break;
+        case OpKind::MOV_R16_FAR16:  cpu.mov(reg16Src, farWord); break;
+        case OpKind::CWD:            cpu.cwd(); break;
+        case OpKind::XLAT:           cpu.xlat(); break;
+        case OpKind::PUSH_IMM:       cpu.push(op.m_value1); break;
+        case OpKind::PUSH_R16:       cpu.push(reg16Src); break;
+        case OpKind::PUSH_NEAR16:    cpu.push(nearWord); break;
+        case OpKind::PUSH_FAR16:     cpu.push(FarWordPtr{ op.m_value2, op.m_value1 }); break;
+        case OpKind::POP:            cpu.pop(); break;
+        case OpKind::POP_R16:        cpu.pop(reg16Dst); break;
+        case OpKind::POP_NEAR16:     cpu.pop(nearWord); break;
+        case OpKind::POP_FAR16:      cpu.pop(FarWordPtr{ op.m_value2, op.m_value1 }); break;
+        case OpKind::PUSHA:          cpu.pusha(); break;
+        case OpKind::POPA:           cpu.popa(); break;
+        case OpKind::ENTER:          cpu.enter(op.m_value1, 0); break;
+        case OpKind::LEAVE:          cpu.leave(); break;
+        case OpKind::MOV_R32_IMM:      cpu.mov(reg32Dst, op.m_imm32); break;
+        case OpKind::MOV_R32_R32:      cpu.mov(reg32Dst, reg32Src); break;
+        case OpKind::MOV_NEAR32_IMM:   cpu.mov(nearDword, op.m_imm32); break;
+        case OpKind::MOV_NEAR32_R32:   cpu.mov(nearDword, reg32Src); break;
+        case OpKind::MOV_R32_NEAR32:   cpu.mov(reg32Src, nearDword); break;
+        case OpKind::MOV_FAR32_IMM:    cpu.mov(farDword, op.m_imm32); break;
+        case OpKind::MOV_FAR32_R32:    cpu.mov(farDword, reg32Src); break;
+        case OpKind::MOV_R32_FAR32:    cpu.mov(reg32Src, farDword); break;
+        case OpKind::PUSHD_IMM:        cpu.pushd(op.m_imm32); break;
+        case OpKind::PUSH_R32:         cpu.push(reg32Src); break;
+        case OpKind::PUSH_FAR32:       cpu.push(FarDwordPtr{ op.m_value2, op.m_value1 }); break;
+        case OpKind::POPD:             cpu.popd(); break;
+        case OpKind::POP_R32:          cpu.pop(reg32Dst); break;
+        case OpKind::POP_FAR32:        cpu.pop(FarDwordPtr{ op.m_value2, op.m_value1 }); break;
+        case OpKind::ADD_R8_IMM:       cpu.add(reg8Dst, byte_t(op.m_value1)); break;
+        case OpKind::ADD_R8_R8:        cpu.add(reg8Dst, reg8Src); break;
+        case OpKind::ADD_R16_IMM:      cpu.add(reg16Dst, op.m_value1); break;
+        case OpKind::ADD_R16_R16:      cpu.add(reg16Dst, reg16Src); break;
+        case OpKind::ADD_R32_IMM:      cpu.add(reg32Dst, op.m_imm32); break;
+        case OpKind::ADD_R32_R32:      cpu.add(reg32Dst, reg32Src); break;
+        case OpKind::ADD_R16_FAR16:    cpu.add(reg16Src, farWord); break;
+        case OpKind::ADD_FAR16_R16:    cpu.add(farWord, reg16Src); break;
+        case OpKind::ADD_R32_FAR32:    cpu.add(reg32Src, farDword); break;
+        case OpKind::ADD_FAR32_R32:    cpu.add(farDword, reg32Src); break;
+        case OpKind::IMUL_R8:          cpu.imul(reg8Src); break;
+        case OpKind::IMUL_R16:         cpu.imul(reg16Src); break;
+        case OpKind::IMUL_R32:         cpu.imul(reg32Src); break;
+        case OpKind::IMUL_R16_R16:     cpu.imul(reg16Dst, reg16Src); break;
+        case OpKind::IMUL_R32_R32:     cpu.imul(reg32Dst, reg32Src); break;
+        case OpKind::IMUL_R16_R16_IMM: cpu.imul(reg16Dst, reg16Src, op.m_value1); break;
+        case OpKind::IMUL_R32_R32_IMM: cpu.imul(reg32Dst, reg32Src, op.m_imm32); break;
+        case OpKind::SHL_R8_IMM:       cpu.shl(reg8Dst, byte_t(op.m_value1)); break;
+        case OpKind::SHL_R16_IMM:      cpu.shl(reg16Dst, byte_t(op.m_value1)); break;
+        case OpKind::SHL_R32_IMM:      cpu.shl(reg32Dst, byte_t(op.m_value1)); break;
+        case OpKind::SHL_R8_CL:        cpu.shl(reg8Dst, R8::CL); break;
+        case OpKind::SHL_R16_CL:       cpu.shl(reg16Dst, R8::CL); break;
+        case OpKind::SHL_R32_CL:       cpu.shl(reg32Dst, R8::CL); break;
+        case OpKind::MOVSB:            cpu.movsb(); break;
+        case OpKind::MOVSW:            cpu.movsw(); break;
+        case OpKind::MOVSD:            cpu.movsd(); break;
+        case OpKind::REP_MOVSB:        cpu.repMovsb(); break;
+        case OpKind::REP_MOVSW:        cpu.repMovsw(); break;
+        case OpKind::REP_MOVSD:        cpu.repMovsd(); break;
+
+        default:
+            assert(!"unknown operation");
+        }
+    }
+
+    class Generator
+    {
+    public:
+        explicit Generator(uint64_t seed)
+        : m_random(seed)
+        {
+        }
+
+        size_t caseLength()
+        {
+            return 1 + next(MAX_CASE_LENGTH);
+        }
+
+        // Word accesses crossing the end of a page and invalid segment values are undefined,
+        // so operations are generated with respect to the current reference state
+        Op operation(const RefMachine& ref)
+        {
+            const word_t sp = ref.reg16(size_t(R16::SP));
+
+            if (sp % 2 || 0xFFFF == sp)
+            {
+                return Op{ OpKind::MOV_R16_IMM, byte_t(R16::SP), 0, word_t(nextWord() & ~1), 0, 0 };
+            }
+
+            Op op = { OpKind(next(size_t(OpKind::COUNT))), 0, 0, 0, 0, 0 };
+
+            switch (op.m_kind)
+            {
+            case OpKind::MOV_R8_IMM:
+            case OpKind::MOV_R8_R8:
+                op.m_reg1 = byte_t(next(8));
+                op.m_reg2 = byte_t(next(8));
+                op.m_value1 = nextWord();
+                break;
+
+            case OpKind::MOV_R16_IMM:
+                op.m_reg1 = byte_t(next(REF_REGISTER_COUNT));
+                op.m_value1 = isSegment(op.m_reg1) ? word_t(next(PAGE_COUNT)) : nextWord();
+                break;
+
+            case OpKind::MOV_R16_R16:
+                op.m_reg2 = byte_t(next(REF_REGISTER_COUNT));
+                op.m_reg1 = isSegment(op.m_reg2) ? byte_t(next(REF_REGISTER_COUNT)) : nonSegment();
+
+                if (isSegment(op.m_reg1) && ref.reg16(op.m_reg2) >= PAGE_COUNT)
+                {
+                    op.m_reg1 = nonSegment();
+                }
+
+                break;
+
+            case OpKind::MOV_NEAR8_IMM:
+            case OpKind::MOV_NEAR8_R8:
+            case OpKind::MOV_R8_NEAR8:
+                op.m_reg2 = byte_t(next(8));
+                op.m_value1 = nextWord();
+                op.m_value2 = nextWord();
+                break;
+
+            case OpKind::MOV_NEAR16_IMM:
+            case OpKind::MOV_NEAR16_R16:
+            case OpKind::MOV_R16_NEAR16:
+            case OpKind::PUSH_NEAR16:
+            case OpKind::POP_NEAR16:
+                op.m_reg2 = nonSegment();
+                op.m_value1 = nextWordOffset();
+                op.m_value2 = nextWord();
+                break;
+
+            case OpKind::MOV_FAR8_IMM:
+            case OpKind::MOV_FAR8_R8:
+            case OpKind::MOV_R8_FAR8:
+                op.m_reg1 = segment();
+                op.m_reg2 = byte_t(next(8));
+                op.m_value1 = nextWord();
+                op.m_value2 = nextWord();
+                break;
+
+            case OpKind::MOV_FAR16_IMM:
+            case OpKind::MOV_FAR16_R16:
+            case OpKind::MOV_R16_FAR16:
+                op.m_reg1 = segment();
+                op.m_reg2 = nonSegment();
+                op.m_value1 = nextWordOffset();
+                op.m_value2 = nextWord();
+                break;
+
+            case OpKind::PUSH_IMM:
+                op.m_value1 = nextWord();
+                break;
+
+            case OpKind::PUSH_R16:
+                op.m_reg2 = byte_t(next(REF_REGISTER_COUNT));
+                break;
+
+            case OpKind::PUSH_FAR16:
+            case OpKind::POP_FAR16:
+                op.m_value1 = nextWordOffset();
+                op.m_value2 = word_t(next(PAGE_COUNT));
+                break;
+
+            case OpKind::POP_R16:
+                op.m_reg1 = nonSegment();
+                break;
+
+            case OpKind::ENTER:
+                op.m_value1 = word_t(next(0x100) & ~1);
+                break;
+
+            case OpKind::LEAVE:
+            {
+                const word_t bp = ref.reg16(size_t(R16::BP));
+
+                if (bp % 2 || 0xFFFF == bp)
+                {
+                    op.m_kind = OpKind::CWD;
+                }
+
+                break;
+            }
+
+            case OpKind::MOV_R32_IMM:
+            case OpKind::MOV_R32_R32:
+            case OpKind::ADD_R32_IMM:
+            case OpKind::ADD_R32_R32:
+            case OpKind::IMUL_R32_R32:
+            case OpKind::IMUL_R32_R32_IMM:
+            case OpKind::SHL_R32_IMM:
+            case OpKind::SHL_R32_CL:
+            case OpKind::ADD_R8_IMM:
+            case OpKind::ADD_R8_R8:
+            case OpKind::IMUL_R8:
+            case OpKind::SHL_R8_IMM:
+            case OpKind::SHL_R8_CL:
+            case OpKind::ADD_R16_IMM:
+            case OpKind::ADD_R16_R16:
+            case OpKind::IMUL_R16_R16:
+            case OpKind::IMUL_R16_R16_IMM:
+            case OpKind::SHL_R16_IMM:
+            case OpKind::SHL_R16_CL:
+            case OpKind::IMUL_R16:
+            case OpKind::IMUL_R32:
+                op.m_reg1 = byte_t(next(REF_GENERAL_REGISTER_COUNT));
+                op.m_reg2 = byte_t(next(REF_GENERAL_REGISTER_COUNT));
+                op.m_value1 = nextWord();
+                op.m_imm32 = nextDword();
+                break;
+
+            case OpKind::MOV_NEAR32_IMM:
+            case OpKind::MOV_NEAR32_R32:
+            case OpKind::MOV_R32_NEAR32:
+                op.m_reg2 = byte_t(next(REF_GENERAL_REGISTER_COUNT));
+                op.m_value1 = nextDwordOffset();
+                op.m_imm32 = nextDword();
+                break;
+
+            case OpKind::MOV_FAR32_IMM:
+            case OpKind::MOV_FAR32_R32:
+            case OpKind::MOV_R32_FAR32:
+            case OpKind::ADD_R32_FAR32:
+            case OpKind::ADD_FAR32_R32:
+                op.m_reg1 = segment();
+                op.m_reg2 = byte_t(next(REF_GENERAL_REGISTER_COUNT));
+                op.m_value1 = nextDwordOffset();
+                op.m_imm32 = nextDword();
+                break;
+
+            case OpKind::ADD_R16_FAR16:
+            case OpKind::ADD_FAR16_R16:
+                op.m_reg1 = segment();
+                op.m_reg2 = byte_t(next(REF_GENERAL_REGISTER_COUNT));
+                op.m_value1 = nextWordOffset();
+                break;
+
+            case OpKind::PUSHD_IMM:
+            case OpKind::PUSH_R32:
+            case OpKind::PUSH_FAR32:
+                // Dword just below the end of stack page would cross it
+                if (2 == sp)
+                {
+                    return Op{ OpKind::MOV_R16_IMM, byte_t(R16::SP), 0, word_t(nextWord() & ~3), 0, 0 };
+                }
+
+                op.m_reg2 = byte_t(next(REF_GENERAL_REGISTER_COUNT));
+                op.m_value1 = nextDwordOffset();
+                op.m_value2 = word_t(next(PAGE_COUNT));
+                op.m_imm32 = nextDword();
+                break;
+
+            case OpKind::POPD:
+            case OpKind::POP_R32:
+            case OpKind::POP_FAR32:
+                if (0xFFFE == sp)
+                {
+                    return Op{ OpKind::MOV_R16_IMM, byte_t(R16::SP), 0, word_t(nextWord() & ~3), 0, 0 };
+                }
+
+                op.m_reg1 = byte_t(next(REF_GENERAL_REGISTER_COUNT));
+                op.m_value1 = nextDwordOffset();
+                op.m_value2 = word_t(next(PAGE_COUNT));
+                break;
+
+            case OpKind::MOVSB:
+            case OpKind::MOVSW:
+            case OpKind::MOVSD:
+            case OpKind::REP_MOVSB:
+            case OpKind::REP_MOVSW:
+            case OpKind::REP_MOVSD:
+            {
+                static const word_t SIZES[] = { 1, 2, 4, 1, 2, 4 };
+                const word_t size = SIZES[size_t(op.m_kind) - size_t(OpKind::MOVSB)];
+                const bool repeat = op.m_kind >= OpKind::REP_MOVSB;
+
+                // Elements must not cross the end of page, including ones after wrap around
+                // of index registers, and repeated moves should be reasonably short
+                const R16 indices[] = { R16::SI, R16::DI };
+
+                for (R16 index : indices)
+                {
+                    const word_t offset = ref.reg16(size_t(index));
+
+                    if (repeat ? 0 != offset % size : offset > 0x10000 - size)
+                    {
+                        return Op{ OpKind::MOV_R16_IMM, byte_t(index), 0, word_t(nextWord() & ~3), 0, 0 };
+                    }
+                }
+
+                if (repeat && ref.reg16(size_t(R16::CX)) > MAX_REP_COUNT)
+                {
+                    return Op{ OpKind::MOV_R16_IMM, byte_t(R16::CX), 0, word_t(next(MAX_REP_COUNT + 1)), 0, 0 };
+                }
+
+                break;
+            }
+
+            default:
+                break;
+            }
+
+            return op;
+        }
+
+    private:
+        std::mt19937_64 m_random;
+
+        size_t next(size_t bound)
+        {
+            return size_t(m_random() % bound);
+        }
+
+        word_t nextWord()
+        {
+            // Favor boundary values, they are the most interesting ones
+            static const word_t SPECIAL[] = { 0, 1, 0x7F, 0x80, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFFFE, 0xFFFF };
+            return next(4) ? word_t(m_random()) : SPECIAL[next(sizeof SPECIAL / sizeof SPECIAL[0])];
+        }
+
+        word_t nextWordOffset()
+        {
+            const word_t offset = nextWord();
+            return 0xFFFF == offset ? 0xFFFE : offset;
+        }
+
+        dword_t nextDword()
+        {
+            static const dword_t SPECIAL[] = { 0, 1, 0x7FFF, 0x8000, 0xFFFF, 0x10000, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFE, 0xFFFFFFFF };
+            return next(4) ? dword_t(m_random()) : SPECIAL[next(sizeof SPECIAL / sizeof SPECIAL[0])];
+        }
+
+        word_t nextDwordOffset()
+        {
+            const word_t offset = nextWord();
+            return offset > 0xFFFC ? 0xFFFC : offset;
+        }
+
+        byte_t nonSegment()
+        {
+            const byte_t reg = byte_t(next(REF_REGISTER_COUNT - 6));
+            return reg < size_t(R16::CS) ? reg : byte_t(R16::FLAGS);
+        }
+
+        byte_t segment()
+        {
+            return byte_t(size_t(R16::CS) + next(6));
+        }
+    };
+
+    struct Failure
+    {
+        uint64_t m_seed;
+        size_t m_case;
+        std::vector<Op> m_ops;
+        const char* m_reason;
+    };
+
+    const char* compareRegisters(const CPU& cpu, const RefMachine& ref)
+    {
+        for (size_t i = 0; i < REF_REGISTER_COUNT; ++i)
+        {
+            if (cpu.value(R16(i)) != ref.reg16(i))
+            {
+                return "16-bit register mismatch";
+            }
+        }
+
+        for (size_t i = 0; i < 8; ++i)
+        {
+            if (cpu.value(R8(i)) != ref.reg8(i))
+            {
+                return "8-bit register mismatch";
+            }
+        }
+
+        for (size_t i = 0; i < REF_GENERAL_REGISTER_COUNT; ++i)
+        {
+            if (cpu.value(R32(i)) != ref.reg32(i))
+            {
+                return "32-bit register mismatch";
+            }
+        }
+
+        return nullptr;
+    }
+
+    const char* compareTouched(const Memory& mem, const RefMachine& ref)
+    {
+        for (const std::pair<word_t, word_t>& address : ref.touched())
+        {
+            if (mem.get<byte_t>(address.first, address.second) != ref.byteAt(address.first, address.second))
+            {
+                return "written memory mismatch";
+            }
+        }
+
+        return nullptr;
+    }
+
+    const char* compareMemory(const Memory& mem, const RefMachine& ref)
+    {
+        for (size_t segment = 0; segment < PAGE_COUNT; ++segment)
+        {
+            for (size_t offset = 0; offset < PAGE_SIZE; ++offset)
+            {
+                if (mem.get<byte_t>(word_t(segment), word_t(offset)) != ref.byteAt(segment, offset))
+                {
+                    return "memory mismatch";
+                }
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool run(uint64_t seed, size_t caseCount, Failure& failure)
+    {
+        Memory mem;
+        CPU cpu(&mem);
+
+        while (mem.pageCount() < PAGE_COUNT)
+        {
+            mem.allocPage();
+        }
+
+        RefMachine ref;
+        Generator generator(seed);
+        std::vector<Op> ops;
+
+        for (size_t i = 0; i < caseCount; ++i)
+        {
+            const size_t length = generator.caseLength();
+            const char* reason = nullptr;
+
+            ops.clear();
+            ref.clearTouched();
+
+            for (size_t j = 0; j < length && nullptr == reason; ++j)
+            {
+                const Op op = generator.operation(ref);
+                ops.push_back(op);
+
+                apply(cpu, op);
+                ref.apply(op);
+
+                reason = compareRegisters(cpu, ref);
+            }
+
+            if (nullptr == reason)
+            {
+                reason = compareTouched(mem, ref);
+            }
+
+            if (nullptr == reason && (i + 1) % FULL_COMPARE_INTERVAL == 0)
+            {
+                reason = compareMemory(mem, ref);
+            }
+
+            if (nullptr != reason)
+            {
+                failure = Failure{ seed, i, ops, reason };
+                return false;
+            }
+        }
+
+        const char* const reason = compareMemory(mem, ref);
+
+        if (nullptr != reason)
+        {
+            failure = Failure{ seed, caseCount, std::vector<Op>(), reason };
+            return false;
+        }
+
+        return true;
+    }
+
+    void report(const Failure& failure)
+    {
+        fprintf(stderr, "FAILED: %s, seed %llu, case %zu\n",
+            failure.m_reason, static_cast<unsigned long long>(failure.m_seed), failure.m_case);
+
+        for (const Op& op : failure.m_ops)
+        {
+            fprintf(stderr, "  %-20s reg1=%u reg2=%u value1=0x%04X value2=0x%04X imm32=0x%08X\n",
+                OP_NAMES[size_t(op.m_kind)], op.m_reg1, op.m_reg2, op.m_value1, op.m_value2, op.m_imm32);
+        }
+    }
+
+} // unnamed namespace
+
+int main(int argc, char** argv)
+{
+    const size_t caseCount = argc > 1 ? size_t(strtoull(argv[1], nullptr, 0)) : 100000;
+    const size_t hardwareThreads = std::thread::hardware_concurrency();
+    const size_t threadCount = argc > 2 ? size_t(strtoull(argv[2], nullptr, 0)) : (0 == hardwareThreads ? 1 : hardwareThreads);
+    const uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 0) : std::random_device()();
+
+    printf("Running %zu cases on each of %zu threads, seed %llu\n",
+        caseCount, threadCount, static_cast<unsigned long long>(seed));
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    std::vector<Failure> failures(threadCount);
+    std::atomic<bool> failed(false);
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            if (!run(seed + i, caseCount, failures[i]))
+            {
+                failed = true;
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (failed)
+    {
+        for (const Failure& failure : failures)
+        {
+            if (nullptr != failure.m_reason)
+            {
+                report(failure);
+            }
+        }
+
+        return EXIT_FAILURE;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double total = double(caseCount) * threadCount;
+
+    printf("Passed %.0f cases in %.2f seconds, %.0f cases per minute\n", total, seconds, total * 60 / seconds);
+
+    return EXIT_SUCCESS;
+}
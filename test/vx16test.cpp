@@ -19,6 +19,17 @@
 #include "vx16.h"
 
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#ifdef VX16_PROFILER
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <thread>
+#endif // VX16_PROFILER
 
 using namespace vx16;
 
@@ -26,7 +37,206 @@ void testMem(Memory& mem)
 {
     assert(mem.pageCount() == 0);
 
-    // TODO: ...
+    const word_t segment = mem.allocPage();
+    assert(segment == 0);
+    assert(mem.pageCount() == 1);
+    assert(mem.get<word_t>(segment, 0) == 0);
+    assert(mem.get<word_t>(segment, 0xFFFE) == 0);
+
+    mem.set<word_t>(segment, 0x100, 0xBEEF);
+    assert(mem.get<byte_t>(segment, 0x100) == 0xEF);
+    assert(mem.get<byte_t>(segment, 0x101) == 0xBE);
+    assert(mem.get(FarWordPtr{ segment, 0x100 }) == 0xBEEF);
+
+    mem.set(FarBytePtr{ segment, 0xFFFF }, 0x42);
+    assert(mem.get(FarBytePtr{ segment, 0xFFFF }) == 0x42);
+
+    mem.set(FarWordPtr{ segment, 0x100 }, 0);
+    mem.set(FarBytePtr{ segment, 0xFFFF }, 0);
+}
+
+// Block expected to be allocated, found by walking control block chain in guest memory, zero if none
+word_t expectedDosBlock(Memory& mem, const DosAllocator& dos, word_t paragraphs)
+{
+    const DosStrategy strategy = dos.strategy();
+    word_t result = 0;
+    word_t resultSize = 0;
+
+    for (word_t mcb = 0; ; )
+    {
+        const word_t offset = mcb * DosAllocator::PARAGRAPH_SIZE;
+        const word_t owner = mem.get(FarWordPtr{ dos.segment(), word_t(offset + DosAllocator::MCB_OWNER) });
+        const word_t size = mem.get(FarWordPtr{ dos.segment(), word_t(offset + DosAllocator::MCB_SIZE) });
+
+        if (0 == owner && size >= paragraphs)
+        {
+            if (DosStrategy::FIRST_FIT == strategy)
+            {
+                return mcb + 1;
+            }
+
+            if (DosStrategy::LAST_FIT == strategy)
+            {
+                result = mcb + 1 + size - paragraphs;
+            }
+            else if (0 == result || size < resultSize)
+            {
+                result = mcb + 1;
+                resultSize = size;
+            }
+        }
+
+        if (DosAllocator::SIGNATURE_LAST == mem.get(FarBytePtr{ dos.segment(), word_t(offset + DosAllocator::MCB_SIGNATURE) }))
+        {
+            return result;
+        }
+
+        mcb += size + 1;
+    }
+}
+
+void testDosAllocator(Memory& mem)
+{
+    DosAllocator dos(&mem);
+    const word_t total = DosAllocator::PARAGRAPH_COUNT - 1;
+    assert(dos.isChainValid());
+    assert(dos.largestFree() == total);
+    assert(dos.strategy() == DosStrategy::FIRST_FIT);
+
+    word_t a = 0, b = 0, c = 0;
+    assert(dos.allocate(0x100, a) == DosError::NONE);
+    assert(dos.allocate(0x200, b, 0x1234) == DosError::NONE);
+    assert(dos.allocate(0x10, c) == DosError::NONE);
+    assert(a == 1 && b == 0x102 && c == 0x303);
+    assert(dos.isChainValid());
+    assert(dos.freeParagraphs() == total - 0x313);
+
+    // Guest view of control block chain
+    const word_t segment = dos.segment();
+    assert(mem.get(FarBytePtr{ segment, 0 }) == 'M');
+    assert(mem.get(FarWordPtr{ segment, 0x1011 }) == 0x1234);
+    assert(mem.get(FarWordPtr{ segment, 0x1013 }) == 0x200);
+    assert(mem.get(FarBytePtr{ segment, 0x3130 }) == 'Z');
+
+    mem.set(FarWordPtr{ dos.address(b).m_segment, dos.address(b).m_offset }, 0xBEEF);
+    assert(mem.get(FarWordPtr{ segment, 0x1020 }) == 0xBEEF);
+
+    // First fit reuses freed block as the lowest one large enough
+    assert(dos.free(b) == DosError::NONE);
+    assert(dos.free(b) == DosError::INVALID_BLOCK);
+    assert(dos.free(0x123) == DosError::INVALID_BLOCK);
+
+    word_t d = 0;
+    assert(dos.allocate(0x200, d) == DosError::NONE);
+    assert(d == b);
+    assert(dos.free(d) == DosError::NONE);
+
+    // Freed neighbors are merged
+    assert(dos.free(a) == DosError::NONE);
+    assert(dos.isChainValid());
+    assert(dos.largestFree() == total - 0x313);
+
+    word_t maximum = 0;
+    assert(dos.allocate(0x301, a) == DosError::NONE);
+    assert(a == 1);
+    assert(dos.resize(a, 0x302, maximum) == DosError::INSUFFICIENT_MEMORY);
+    assert(maximum == 0x301);
+    assert(dos.resize(a, 0x80, maximum) == DosError::NONE);
+    assert(dos.resize(a, 0x301, maximum) == DosError::NONE);
+    assert(dos.isChainValid());
+
+    // The last block grows up to the end of page, even when resize fails
+    assert(dos.resize(c, 0xFFFF, maximum) == DosError::INSUFFICIENT_MEMORY);
+    assert(maximum == total - 0x302);
+    assert(dos.largestFree() == 0);
+    assert(dos.resize(c, maximum, maximum) == DosError::NONE);
+    assert(dos.allocate(1, d) == DosError::INSUFFICIENT_MEMORY);
+    assert(d == 0);
+    assert(dos.isChainValid());
+
+    // Damaged control block is detected
+    mem.set(FarBytePtr{ segment, 0 }, 0);
+    assert(dos.free(a) == DosError::MCB_DESTROYED);
+    assert(!dos.isChainValid());
+    mem.set(FarBytePtr{ segment, 0 }, 'M');
+
+    assert(dos.free(a) == DosError::NONE);
+    assert(dos.free(c) == DosError::NONE);
+    assert(dos.largestFree() == total);
+    assert(dos.isChainValid());
+
+    // Free blocks of 0x300 and 0x100 paragraphs at the bottom, the rest at the top
+    word_t guard = 0;
+    assert(dos.allocate(0x300, a) == DosError::NONE);
+    assert(dos.allocate(0x10, b) == DosError::NONE);
+    assert(dos.allocate(0x100, c) == DosError::NONE);
+    assert(dos.allocate(0x10, guard) == DosError::NONE);
+    assert(c == 0x313 && guard == 0x414);
+    assert(dos.free(a) == DosError::NONE);
+    assert(dos.free(c) == DosError::NONE);
+
+    assert(dos.allocate(0x80, d) == DosError::NONE);
+    assert(d == 1);
+    assert(dos.free(d) == DosError::NONE);
+
+    dos.setStrategy(DosStrategy::BEST_FIT);
+    assert(dos.allocate(0x80, d) == DosError::NONE);
+    assert(d == 0x313);
+    assert(dos.free(d) == DosError::NONE);
+
+    dos.setStrategy(DosStrategy::LAST_FIT);
+    assert(dos.allocate(0x80, d) == DosError::NONE);
+    assert(d == DosAllocator::PARAGRAPH_COUNT - 0x80);
+    assert(mem.get(FarBytePtr{ segment, word_t((d - 1) * DosAllocator::PARAGRAPH_SIZE) }) == 'Z');
+    assert(dos.isChainValid());
+    assert(dos.free(d) == DosError::NONE);
+    dos.setStrategy(DosStrategy::FIRST_FIT);
+
+    assert(dos.free(b) == DosError::NONE);
+    assert(dos.free(guard) == DosError::NONE);
+    assert(dos.largestFree() == total);
+    assert(dos.isChainValid());
+
+    // Random allocations and frees with every strategy agree with search over control block chain
+    std::mt19937 random(1);
+    std::vector<word_t> blocks;
+
+    for (int i = 0; i < 3000; ++i)
+    {
+        dos.setStrategy(static_cast<DosStrategy>(random() % 3));
+
+        if (blocks.empty() || random() % 5 < 3)
+        {
+            const word_t paragraphs = static_cast<word_t>(random() % 0x200);
+            const word_t expected = expectedDosBlock(mem, dos, paragraphs);
+
+            word_t block = 0;
+            const DosError error = dos.allocate(paragraphs, block);
+            assert((0 == expected) == (DosError::INSUFFICIENT_MEMORY == error));
+
+            if (DosError::NONE == error)
+            {
+                assert(block == expected);
+                blocks.push_back(block);
+            }
+        }
+        else
+        {
+            const size_t index = random() % blocks.size();
+            assert(dos.free(blocks[index]) == DosError::NONE);
+            blocks.erase(blocks.begin() + index);
+        }
+
+        assert(dos.isChainValid());
+    }
+
+    for (word_t block : blocks)
+    {
+        assert(dos.free(block) == DosError::NONE);
+    }
+
+    assert(dos.largestFree() == total);
+    dos.setStrategy(DosStrategy::FIRST_FIT);
 }
 
 void testInit(CPU& cpu)
@@ -293,6 +503,458 @@ void testPushaPopa(CPU& cpu, Memory& mem)
     assert(cpu.sp() == 0x3210);
 }
 
+void testCallRet(CPU& cpu, Memory& mem)
+{
+    cpu.mov(R16::SP, 0x2000);
+    cpu.mov(R16::CS, 0x1234);
+    assert(cpu.callDepth() == 0);
+
+    // Near call with two word arguments
+    cpu.push(0x1111);
+    cpu.push(0x2222);
+    cpu.call(0x0100);
+    assert(cpu.sp() == 0x1FFA);
+    assert(mem.get<word_t>(cpu.ss(), 0x1FFA) == 0x0100);
+    assert(cpu.callDepth() == 1);
+
+    // Nested far call
+    cpu.callf(0x5678, 0x0200);
+    assert(cpu.cs() == 0x5678);
+    assert(cpu.sp() == 0x1FF6);
+    assert(mem.get<word_t>(cpu.ss(), 0x1FF6) == 0x0200);
+    assert(mem.get<word_t>(cpu.ss(), 0x1FF8) == 0x1234);
+    assert(cpu.callDepth() == 2);
+    assert(cpu.callStack().back().m_kind == CallKind::FAR);
+    assert(cpu.callStack().front().m_returnOffset == 0x0100);
+
+    // Interrupt handler saves flags and clears IF and TF
+    cpu.mov(R16::FLAGS, 0x0302);
+    cpu.callInt(0x9ABC, 0x0300);
+    assert(cpu.cs() == 0x9ABC);
+    assert(cpu.flags() == 0x0002);
+    assert(mem.get<word_t>(cpu.ss(), cpu.sp() + 4) == 0x0302);
+
+    cpu.push(R16::AX);
+    cpu.pop(R16::AX);
+    assert(cpu.iret() == 0x0300);
+    assert(cpu.flags() == 0x0302);
+    assert(cpu.cs() == 0x5678);
+
+    // Far jump switches code segment within the current frame, return restores caller's one
+    assert(cpu.jmpf(0x6789, 0x0280) == 0x0280);
+    assert(cpu.cs() == 0x6789);
+    assert(cpu.sp() == 0x1FF6);
+    assert(cpu.callDepth() == 2);
+
+    assert(cpu.retf() == 0x0200);
+    assert(cpu.cs() == 0x1234);
+    assert(cpu.sp() == 0x1FFA);
+
+    assert(cpu.ret(4) == 0x0100);
+    assert(cpu.sp() == 0x2000);
+    assert(cpu.callDepth() == 0);
+    assert(cpu.unmatchedReturnCount() == 0);
+
+    // Returns to addresses pushed by guest code are computed jumps without matching call
+    cpu.push(0x1234);
+    assert(cpu.ret() == 0x1234);
+    assert(cpu.sp() == 0x2000);
+    assert(cpu.callDepth() == 0);
+    assert(cpu.unmatchedReturnCount() == 1);
+
+    cpu.push(0x4321);
+    cpu.push(0x0400);
+    assert(cpu.retf() == 0x0400);
+    assert(cpu.cs() == 0x4321);
+    assert(cpu.sp() == 0x2000);
+    assert(cpu.callDepth() == 0);
+    assert(cpu.unmatchedReturnCount() == 2);
+
+    // Computed jump within called routine keeps its frame
+    cpu.call(0x0500);
+    cpu.push(0x0600);
+    assert(cpu.ret() == 0x0600);
+    assert(cpu.callDepth() == 1);
+    assert(cpu.ret() == 0x0500);
+    assert(cpu.callDepth() == 0);
+    assert(cpu.unmatchedReturnCount() == 3);
+
+    // Return of outer routine unwinds frames of inner ones abandoned by stack reset
+    cpu.call(0x0700);
+    cpu.callf(0x1111, 0x0800);
+    cpu.mov(R16::SP, 0x1FFE);
+    assert(cpu.ret() == 0x0700);
+    assert(cpu.callDepth() == 0);
+    assert(cpu.unmatchedReturnCount() == 4);
+
+    cpu.mov(R16::CS, 0x1234);
+    cpu.mov(R16::FLAGS, 2);
+}
+
+#ifdef VX16_WATCHPOINTS
+
+void testWatch(CPU& cpu, Memory& mem)
+{
+    size_t readHits = 0;
+    size_t writeHits = 0;
+    word_t lastAX = 0;
+
+    const size_t readID = mem.watch(cpu.ds(), 0x2000, 4, Watch::READ,
+        [&](const WatchHit& hit)
+        {
+            assert(hit.m_cpu == &cpu);
+            assert(hit.m_access == Watch::READ);
+            ++readHits;
+        });
+    const size_t writeID = mem.watch(cpu.ds(), 0x2002, 2, Watch::WRITE,
+        [&](const WatchHit& hit)
+        {
+            assert(hit.m_segment == cpu.ds());
+            assert(hit.m_access == Watch::WRITE);
+            lastAX = hit.m_cpu->ax();
+            ++writeHits;
+        });
+    assert(mem.watchCount() == 2);
+
+    // Same 4 KB block, outside of watched ranges
+    cpu.mov(R16::AX, 0x1357);
+    cpu.mov(cpu.wordPtr(0x2010), R16::AX);
+    cpu.mov(R16::BX, cpu.wordPtr(0x2010));
+    assert(readHits == 0);
+    assert(writeHits == 0);
+
+    cpu.mov(cpu.wordPtr(0x2000), R16::AX);
+    assert(writeHits == 0);
+    cpu.mov(cpu.wordPtr(0x2001), R16::AX);
+    assert(writeHits == 1);
+    assert(lastAX == 0x1357);
+
+    cpu.mov(R16::CX, cpu.wordPtr(0x1FFF));
+    assert(readHits == 1);
+    cpu.mov(R16::CX, cpu.wordPtr(0x2004));
+    assert(readHits == 1);
+
+    mem.unwatch(readID);
+    cpu.mov(R16::CX, cpu.wordPtr(0x2000));
+    assert(readHits == 1);
+
+    mem.unwatch(writeID);
+    cpu.mov(cpu.wordPtr(0x2002), R16::AX);
+    assert(writeHits == 1);
+    assert(mem.watchCount() == 0);
+
+    // Callback removes its watchpoint and adds another one, which is not reported for the same access
+    size_t addedHits = 0;
+    size_t laterHits = 0;
+
+    mem.watch(cpu.ds(), 0x3000, 2, Watch::WRITE,
+        [&](const WatchHit& hit)
+        {
+            mem.unwatch(hit.m_id);
+            mem.watch(cpu.ds(), 0x3000, 2, Watch::WRITE, [&](const WatchHit&) { ++addedHits; });
+        });
+    const size_t laterID = mem.watch(cpu.ds(), 0x3000, 2, Watch::WRITE, [&](const WatchHit&) { ++laterHits; });
+
+    cpu.mov(cpu.wordPtr(0x3000), R16::AX);
+    assert(addedHits == 0);
+    assert(laterHits == 1);
+    assert(mem.watchCount() == 2);
+
+    cpu.mov(cpu.wordPtr(0x3000), R16::AX);
+    assert(addedHits == 1);
+    assert(laterHits == 2);
+
+    mem.unwatch(laterID);
+    mem.unwatch(laterID + 1);
+    assert(mem.watchCount() == 0);
+
+    // Destroyed CPU is detached from memory
+    {
+        CPU other(&mem);
+    }
+
+    const size_t detachedID = mem.watch(cpu.ds(), 0x2000, 2, Watch::READ,
+        [&](const WatchHit& hit)
+        {
+            assert(nullptr == hit.m_cpu);
+            ++readHits;
+        });
+    cpu.mov(R16::CX, cpu.wordPtr(0x2000));
+    assert(readHits == 2);
+
+    mem.unwatch(detachedID);
+    mem.attachCPU(&cpu);
+}
+
+#endif // VX16_WATCHPOINTS
+
+#ifdef VX16_PROFILER
+
+template <typename T, typename U>
+void profiledTemplate(CPU& cpu)
+{
+    cpu.call(0x20);
+    cpu.mov(R16::AX, word_t(sizeof(T) + sizeof(U)));
+    cpu.ret();
+}
+
+void testProfiler(CPU& cpu)
+{
+    Profiler::reset();
+
+    const uint32_t line = std::source_location::current().line() + 3;
+    for (int i = 0; i < 10; ++i)
+    {
+        cpu.push(R16::AX);
+    }
+
+    // Another thread with its own table, merged on export
+    std::thread thread([]()
+    {
+        Memory mem;
+        CPU cpu(&mem);
+
+        for (int i = 0; i < 5; ++i)
+        {
+            cpu.pusha();
+        }
+    });
+    thread.join();
+
+    const Profiler::Sites sites = Profiler::sites();
+    assert(sites.size() == 2);
+    assert(sites[0].m_callers.empty());
+    assert(sites[1].m_callers.empty());
+
+    const Profiler::Site* pushSite = nullptr;
+    const Profiler::Site* pushaSite = nullptr;
+
+    for (const Profiler::Site& site : sites)
+    {
+        (site.m_line == line ? pushSite : pushaSite) = &site;
+    }
+
+    assert(nullptr != pushSite && nullptr != pushaSite);
+    assert(pushSite->m_instructions == 10);
+    assert(pushSite->m_bytes == 20);
+    assert(pushaSite->m_instructions == 5);
+    assert(pushaSite->m_bytes == 80);
+
+    std::ostringstream folded;
+    Profiler::writeFolded(folded);
+    assert(folded.str().find("vx16test.cpp:" + std::to_string(line) + " 10\n") != std::string::npos);
+
+    Profiler::reset();
+    assert(Profiler::sites().empty());
+
+    // Instructions executed by called routine, including return, are attributed to call chain
+    cpu.mov(R16::SP, 0x1000);
+    cpu.call(0x10);
+    const uint32_t calleeLine = std::source_location::current().line() + 1;
+    cpu.mov(R16::AX, 1);
+    cpu.ret();
+
+    const std::string caller = std::source_location::current().function_name();
+    bool calleeFound = false;
+
+    for (const Profiler::Site& site : Profiler::sites())
+    {
+        if (site.m_line == calleeLine || site.m_line == calleeLine + 1)
+        {
+            assert(site.m_callers == caller);
+            calleeFound = true;
+        }
+        else
+        {
+            assert(site.m_callers.empty());
+        }
+    }
+
+    assert(calleeFound);
+    Profiler::reset();
+
+    // Semicolons in template signatures don't split frames of folded stacks
+    profiledTemplate<int, char>(cpu);
+
+    std::ostringstream templateFolded;
+    Profiler::writeFolded(templateFolded);
+    std::istringstream templateLines(templateFolded.str());
+    size_t templateFrames = 0;
+
+    for (std::string foldedLine; std::getline(templateLines, foldedLine); )
+    {
+        size_t frames = 0;
+
+        for (size_t pos = foldedLine.find("profiledTemplate"); std::string::npos != pos; pos = foldedLine.find("profiledTemplate", pos + 1))
+        {
+            ++frames;
+        }
+
+        assert(size_t(std::count(foldedLine.begin(), foldedLine.end(), ';')) == frames);
+        templateFrames += frames;
+    }
+
+    assert(templateFrames == 5);
+    Profiler::reset();
+}
+
+#endif // VX16_PROFILER
+
+void testRegisters32(CPU& cpu, Memory& mem)
+{
+    cpu.mov(R32::EAX, 0x12345678);
+    assert(cpu.ax() == 0x5678);
+    assert(cpu.al() == 0x78);
+    assert(cpu.ah() == 0x56);
+
+    cpu.mov(R16::AX, 0xABCD);
+    assert(cpu.eax() == 0x1234ABCD);
+    cpu.mov(R32::EBX, 0x11223344);
+    cpu.mov(R8::BH, 0x42);
+    assert(cpu.ebx() == 0x11224244);
+
+    cpu.mov(R32::ESI, R32::EAX);
+    assert(cpu.esi() == 0x1234ABCD);
+    assert(cpu.value(R16::SI) == 0xABCD);
+
+    // Segment registers and flags are not affected by extended register layout
+    const word_t ds = cpu.ds();
+    cpu.mov(R32::EDI, 0xFFFFFFFF);
+    assert(cpu.ds() == ds && cpu.flags() == 2);
+
+    cpu.mov(NearDwordPtr{ 0x100 }, R32::ESI);
+    assert(mem.get(FarWordPtr{ ds, 0x102 }) == 0x1234);
+    cpu.mov(R32::ECX, cpu.dwordPtr(0x100));
+    assert(cpu.ecx() == 0x1234ABCD);
+
+    cpu.mov(R16::SP, 0x100);
+    cpu.push(R32::ECX);
+    cpu.pushd(0xDEADBEEF);
+    assert(cpu.sp() == 0xF8);
+    cpu.pop(R32::EDX);
+    assert(cpu.edx() == 0xDEADBEEF);
+    assert(cpu.popd() == 0x1234ABCD);
+    assert(cpu.sp() == 0x100);
+
+    cpu.mov(R32::EDI, 0);
+    cpu.mov(R32::ESI, 0);
+    cpu.mov(NearDwordPtr{ 0x100 }, 0);
+}
+
+void testArithmetic(CPU& cpu)
+{
+    cpu.mov(R8::AL, 0x7F);
+    cpu.add(R8::AL, 1);
+    assert(cpu.al() == 0x80);
+    assert(!cpu.cf() && cpu.of() && cpu.af() && cpu.sf() && !cpu.zf() && !cpu.pf());
+
+    cpu.mov(R16::BX, 0xFFFF);
+    cpu.add(R16::BX, 1);
+    assert(cpu.bx() == 0);
+    assert(cpu.cf() && !cpu.of() && cpu.zf() && cpu.pf());
+
+    cpu.mov(R32::EAX, 0x00010000);
+    cpu.mov(R32::ECX, 0xFFFF0000);
+    cpu.add(R32::ECX, R32::EAX);
+    assert(cpu.ecx() == 0 && cpu.cf() && cpu.zf());
+
+    // 16.16 fixed point multiplication, 1.5 * -2.25
+    cpu.mov(R32::EAX, 0x00018000);
+    cpu.mov(R32::EBX, 0xFFFDC000);
+    cpu.imul(R32::EBX);
+    assert(cpu.edx() == 0xFFFFFFFC && cpu.eax() == 0xA0000000); // -3.375 in EDX:EAX >> 16
+    assert(cpu.cf() && cpu.of());
+
+    cpu.mov(R16::AX, 0x100);
+    cpu.imul(R16::AX, R16::AX, 0x7F);
+    assert(cpu.ax() == 0x7F00 && !cpu.cf() && !cpu.of());
+
+    cpu.mov(R8::AL, 0xFF);
+    cpu.mov(R8::BL, 0xFF);
+    cpu.imul(R8::BL);
+    assert(cpu.ax() == 1 && !cpu.cf());
+
+    cpu.mov(R32::EDX, 0xC0000001);
+    cpu.shl(R32::EDX, 1);
+    assert(cpu.edx() == 0x80000002 && cpu.cf() && !cpu.of() && cpu.sf());
+
+    cpu.mov(R8::CL, 33);
+    cpu.shl(R32::EDX, R8::CL);
+    assert(cpu.edx() == 0x00000004 && cpu.cf() && cpu.of() && !cpu.sf());
+
+    cpu.mov(R16::FLAGS, 2);
+}
+
+void testMovs(CPU& cpu, Memory& mem)
+{
+    const word_t segment = mem.allocPage();
+    const word_t ds = cpu.ds();
+    const word_t es = cpu.es();
+
+    for (word_t i = 0; i < 0x40; ++i)
+    {
+        mem.set(FarBytePtr{ segment, i }, byte_t(i));
+    }
+
+    cpu.mov(R16::DS, segment);
+    cpu.mov(R16::ES, segment);
+
+    // Non-overlapping forward copy is done at once
+    cpu.mov(R16::SI, 0);
+    cpu.mov(R16::DI, 0x100);
+    cpu.mov(R16::CX, 0x10);
+    cpu.repMovsd();
+    assert(cpu.si() == 0x40 && cpu.di() == 0x140 && cpu.cx() == 0);
+    assert(mem.get(FarDwordPtr{ segment, 0x13C }) == 0x3F3E3D3C);
+
+    // Overlapping copy replicates the pattern like on real hardware
+    cpu.mov(R16::SI, 0x100);
+    cpu.mov(R16::DI, 0x102);
+    cpu.mov(R16::CX, 4);
+    cpu.repMovsw();
+    assert(mem.get(FarDwordPtr{ segment, 0x104 }) == 0x01000100);
+    assert(mem.get(FarWordPtr{ segment, 0x10A }) == 0x0B0A);
+
+    // Backward copy
+    cpu.mov(R16::FLAGS, 0x402);
+    cpu.mov(R16::SI, 3);
+    cpu.mov(R16::DI, 0x203);
+    cpu.mov(R16::CX, 4);
+    cpu.repMovsb();
+    assert(cpu.si() == 0xFFFF && cpu.di() == 0x1FF);
+    assert(mem.get(FarDwordPtr{ segment, 0x200 }) == 0x03020100);
+
+    cpu.movsb();
+    assert(cpu.si() == 0xFFFE && cpu.di() == 0x1FE);
+
+    cpu.mov(R16::FLAGS, 2);
+    cpu.mov(R16::SI, 0x20);
+    cpu.mov(R16::DI, 0x300);
+    cpu.movsd();
+    assert(mem.get(FarDwordPtr{ segment, 0x300 }) == 0x23222120);
+    assert(cpu.si() == 0x24 && cpu.di() == 0x304);
+
+#ifdef VX16_WATCHPOINTS
+    // Watched destination disables bulk copy, so every element move is reported
+    size_t hits = 0;
+    const size_t id = mem.watch(segment, 0x400, 0x10, Watch::WRITE, [&hits](const WatchHit&) { ++hits; });
+
+    cpu.mov(R16::SI, 0);
+    cpu.mov(R16::DI, 0x400);
+    cpu.mov(R16::CX, 4);
+    cpu.repMovsd();
+    assert(4 == hits);
+    assert(mem.get(FarDwordPtr{ segment, 0x40C }) == 0x0F0E0D0C);
+
+    mem.unwatch(id);
+#endif // VX16_WATCHPOINTS
+
+    cpu.mov(R16::DS, ds);
+    cpu.mov(R16::ES, es);
+    cpu.mov(R16::SI, 0);
+    cpu.mov(R16::DI, 0);
+}
+
 void testEnterLeave(CPU& cpu)
 {
     cpu.mov(R16::SP, 0x100);
@@ -308,10 +970,202 @@ void testEnterLeave(CPU& cpu)
     assert(cpu.bp() == 0x200);
 }
 
+void testFPU(CPU& cpu, Memory& mem)
+{
+    FPU& fpu = cpu.fpu();
+    const word_t segment = mem.allocPage();
+
+    // Fast mode
+    cpu.finit();
+    assert(fpu.controlWord() == FPU::DEFAULT_CONTROL_WORD);
+    assert(fpu.tagWord() == 0xFFFF);
+
+    mem.set(FarQwordPtr{ segment, 0 }, 0x4004000000000000ull); // 2.5
+    mem.set(FarWordPtr{ segment, 8 }, 3);
+    cpu.fld(FarQwordPtr{ segment, 0 });
+    cpu.fimul(FarWordPtr{ segment, 8 });
+    assert(fpu.st(ST::ST0) == 7.5);
+
+    cpu.fld1();
+    cpu.faddp();
+    assert(fpu.st(ST::ST0) == 8.5);
+    assert(fpu.statusWord() == 0x3800);
+
+    cpu.fistp(FarWordPtr{ segment, 10 });
+    assert(mem.get(FarWordPtr{ segment, 10 }) == 8);
+    assert(fpu.tagWord() == 0xFFFF);
+
+    cpu.fldpi();
+    cpu.fldz();
+    cpu.fcomp();
+    cpu.fstsw(R16::AX);
+    cpu.sahf();
+    assert((cpu.flags() & 0x0041) == 0x0001); // 0 < pi, CF set, ZF clear
+
+    cpu.fchs();
+    cpu.fabs();
+    cpu.fsqrt();
+    cpu.fmul(ST::ST0, ST::ST0);
+    cpu.fstp(FarDwordPtr{ segment, 0 });
+    assert(mem.get(FarDwordPtr{ segment, 0 }) == 0x40490FDB); // float pi
+
+    cpu.fld1();
+    cpu.fldz();
+    cpu.fdivp();
+    assert(std::isinf(fpu.st(ST::ST0)));
+    assert(fpu.statusWord() & FPU::STATUS_ZERO_DIVIDE);
+    cpu.fclex();
+    cpu.fstp(ST::ST0);
+
+    // Stack underflow produces indefinite and stack fault
+    cpu.fadd(ST::ST0, ST::ST1);
+    assert((fpu.statusWord() & 0x0241) == 0x0041);
+
+    // Exact mode
+    cpu.finit();
+    fpu.setMode(FPUMode::EXACT);
+
+    cpu.fldpi();
+    Float80 pi = fpu.stExtended(ST::ST0);
+    assert(pi.m_significand == 0xC90FDAA22168C235ull && pi.m_signExponent == 0x4000);
+
+    // Rounding control affects constants
+    mem.set(FarWordPtr{ segment, 0 }, FPU::DEFAULT_CONTROL_WORD | 0x0400);
+    cpu.fldcw(FarWordPtr{ segment, 0 });
+    cpu.fldpi();
+    pi = fpu.stExtended(ST::ST0);
+    assert(pi.m_significand == 0xC90FDAA22168C234ull);
+
+    // Precision control rounds arithmetic result to 24 bits
+    mem.set(FarWordPtr{ segment, 0 }, 0x007F);
+    cpu.fldcw(FarWordPtr{ segment, 0 });
+    cpu.fadd(ST::ST0, ST::ST1);
+    assert(fpu.stExtended(ST::ST0).m_significand == 0xC90FDB0000000000ull);
+    assert(fpu.statusWord() & FPU::STATUS_PRECISION);
+
+    // Round to integer with all rounding modes
+    static const word_t ROUNDINGS[] = { 0x0000, 0x0400, 0x0800, 0x0C00 };
+    static const int16_t EXPECTED[][2] = { { 2, -2 }, { 2, -3 }, { 3, -2 }, { 2, -2 } };
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        mem.set(FarWordPtr{ segment, 0 }, word_t(0x037F | ROUNDINGS[i]));
+        cpu.fldcw(FarWordPtr{ segment, 0 });
+
+        mem.set(FarQwordPtr{ segment, 8 }, 0x4004000000000000ull); // 2.5
+        cpu.fld(FarQwordPtr{ segment, 8 });
+        cpu.fist(FarWordPtr{ segment, 16 });
+        cpu.fchs();
+        cpu.frndint();
+        cpu.fistp(FarWordPtr{ segment, 18 });
+        assert(int16_t(mem.get(FarWordPtr{ segment, 16 })) == EXPECTED[i][0]);
+        assert(int16_t(mem.get(FarWordPtr{ segment, 18 })) == EXPECTED[i][1]);
+    }
+
+    // Integer overflow stores indefinite
+    cpu.fld(FarQwordPtr{ segment, 8 });
+    cpu.fild(FarWordPtr{ segment, 20 });
+    mem.set(FarDwordPtr{ segment, 20 }, 100000);
+    cpu.fild(FarDwordPtr{ segment, 20 });
+    cpu.fistp(FarWordPtr{ segment, 24 });
+    assert(mem.get(FarWordPtr{ segment, 24 }) == 0x8000);
+
+    // Switching mode keeps register contents
+    fpu.setMode(FPUMode::FAST);
+    assert(fpu.st(ST::ST1) == 2.5);
+
+#if (defined __i386__ || defined __x86_64__) && LDBL_MANT_DIG == 64
+    // Compare exact mode against host x87
+    cpu.finit();
+    fpu.setMode(FPUMode::EXACT);
+
+    std::mt19937_64 random(16);
+
+    const auto makeValue = [&random]()
+    {
+        static const word_t SPECIAL[] = { 0x0000, 0x7FFF };
+        const qword_t significand = random();
+        const word_t sign = word_t(random() & 0x8000);
+        const unsigned kind = random() % 16;
+
+        if (0 == kind)
+        {
+            return Float80{ significand & 0x7FFFFFFFFFFFFFFFull, word_t(sign) };
+        }
+        else if (1 == kind)
+        {
+            return Float80{ 2 == (random() & 3) ? 0x8000000000000000ull : significand | 0x8000000000000000ull, word_t(sign | SPECIAL[1]) };
+        }
+        else if (2 == kind)
+        {
+            return Float80{ 0, word_t(sign | SPECIAL[0]) };
+        }
+
+        const word_t exponent = word_t(0x3FFF + int(random() % 256) - 128);
+        return Float80{ significand | 0x8000000000000000ull, word_t(sign | exponent) };
+    };
+
+    const auto toHost = [](const Float80& value)
+    {
+        long double result = 0;
+        memcpy(&result, &value, 10);
+        return result;
+    };
+
+    const auto isSame = [&toHost](const Float80& value, long double expected)
+    {
+        Float80 host = {};
+        memcpy(&host, &expected, 10);
+        return host.m_significand == value.m_significand && host.m_signExponent == value.m_signExponent;
+    };
+
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        const Float80 lhs = makeValue();
+        const Float80 rhs = makeValue();
+        const volatile long double hostLhs = toHost(lhs);
+        const volatile long double hostRhs = toHost(rhs);
+
+        mem.set(FarTbytePtr{ segment, 0 }, lhs);
+        mem.set(FarTbytePtr{ segment, 16 }, rhs);
+
+        const auto check = [&](FPUOperation operation, long double expected)
+        {
+            cpu.fld(FarTbytePtr{ segment, 16 });
+            cpu.fld(FarTbytePtr{ segment, 0 });
+            fpu.arithmetic(operation, ST::ST0, ST::ST1, false);
+            assert(isSame(fpu.stExtended(ST::ST0), expected));
+            cpu.fstp(ST::ST0);
+            cpu.fstp(ST::ST0);
+        };
+
+        check(FPUOperation::ADD, hostLhs + hostRhs);
+        check(FPUOperation::SUB, hostLhs - hostRhs);
+        check(FPUOperation::MUL, hostLhs * hostRhs);
+        check(FPUOperation::DIV, hostLhs / hostRhs);
+
+        cpu.fld(FarTbytePtr{ segment, 0 });
+        cpu.fsqrt();
+        assert(isSame(fpu.stExtended(ST::ST0), sqrtl(hostLhs)));
+
+        cpu.fst(FarQwordPtr{ segment, 32 });
+        const double hostDouble = static_cast<double>(sqrtl(hostLhs));
+        qword_t hostBits = 0;
+        memcpy(&hostBits, &hostDouble, sizeof hostBits);
+        assert(mem.get(FarQwordPtr{ segment, 32 }) == hostBits);
+        cpu.fstp(ST::ST0);
+    }
+
+    fpu.setMode(FPUMode::FAST);
+#endif // x87 host
+    cpu.finit();
+}
+
 int main()
 {
     Memory mem;
     testMem(mem);
+    testDosAllocator(mem);
 
     CPU cpu(&mem);
     testInit(cpu);
@@ -323,4 +1177,15 @@ int main()
     testPushPop(cpu, mem);
     testPushaPopa(cpu, mem);
     testEnterLeave(cpu);
+    testRegisters32(cpu, mem);
+    testArithmetic(cpu);
+    testMovs(cpu, mem);
+    testCallRet(cpu, mem);
+    testFPU(cpu, mem);
+#ifdef VX16_WATCHPOINTS
+    testWatch(cpu, mem);
+#endif // VX16_WATCHPOINTS
+#ifdef VX16_PROFILER
+    testProfiler(cpu);
+#endif // VX16_PROFILER
 }